@@ -0,0 +1,327 @@
+/*
+ * cellular_city_arena.h
+ *
+ * Arena de objetos pequenos (--packetArena). Cada pacote de subida cria e
+ * destrói, entre o UE e o UdpServer, vários objetos pequenos (Packet,
+ * Buffer::Data, PacketMetadata::Data, cabeçalhos copiados, eventos), dezenas
+ * de milhões por segundo simulado na simulação multi-célula. Com a arena, o
+ * operator new/delete do programa (CELLULAR_CITY_ARENA_OPERATORS, uma vez no
+ * .cc) serve os pedidos de até kMaxSize bytes de listas livres por classe
+ * de tamanho (múltiplos de 16 bytes): o que o UdpServer libera ao receber
+ * um pacote volta para a lista e é reutilizado pelo próximo envio, sem
+ * passar pelo malloc.
+ *
+ * A substituição do operator new/delete vale para o programa inteiro, então
+ * só é compilada com -DCELLULAR_CITY_PACKET_ARENA; sem a definição o macro
+ * não expande para nada e as alocações não pagam nenhuma verificação. O
+ * Buffer e o PacketMetadata do ns-3 já reaproveitam os seus dados e o tcache
+ * do glibc já tem classes por thread: o ganho deve ser medido com o
+ * cellular_city_benchmark, com e sem a definição, antes de usar a arena.
+ *
+ * As classes ocupam páginas de kPageSize bytes de uma região virtual
+ * reservada com mmap (MAP_NORESERVE; a memória física só é usada quando
+ * tocada). Um ponteiro pertence à arena se está dentro da região, e a página
+ * diz a classe, então os blocos não têm cabeçalho. As páginas não voltam ao
+ * sistema nem mudam de classe: um pico de uma classe fica reservado para
+ * ela até o fim. Só a thread que chamou Enable() usa as listas (o simulador do
+ * ns-3 roda em uma thread); outras threads usam o malloc, e um bloco da
+ * arena liberado por elas entra em uma lista protegida por trava.
+ */
+
+#ifndef CELLULAR_CITY_ARENA_H
+#define CELLULAR_CITY_ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <string>
+
+#include <sys/mman.h>
+
+namespace ns3
+{
+
+class SmallObjectArena
+{
+  public:
+    static constexpr size_t kGranule = 16;
+    static constexpr size_t kMaxSize = 1024;
+    static constexpr uint32_t kClasses = kMaxSize / kGranule;
+    static constexpr size_t kPageSize = 64 * 1024;
+    static constexpr size_t kRegionSize = size_t(256) << 30; // virtual
+#ifdef CELLULAR_CITY_PACKET_ARENA
+    static constexpr bool kCompiled = true;
+#else
+    static constexpr bool kCompiled = false;
+#endif
+
+    struct ClassStats
+    {
+        uint64_t allocations;
+        uint64_t live;
+        uint64_t peakLive;
+    };
+
+    static SmallObjectArena& Get()
+    {
+        return s_arena;
+    }
+
+    /// Reserva a região e passa a servir a thread atual. Devolve false se o
+    /// mmap falhar (a arena continua desligada).
+    bool Enable()
+    {
+        if (!kCompiled)
+        {
+            return false;
+        }
+        if (m_base)
+        {
+            return true;
+        }
+        void* region = mmap(nullptr, kRegionSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        void* classes = mmap(nullptr, kRegionSize / kPageSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED || classes == MAP_FAILED)
+        {
+            return false;
+        }
+        m_pageClass = static_cast<uint8_t*>(classes);
+        m_base = static_cast<char*>(region);
+        t_owner = true;
+        return true;
+    }
+
+    bool IsEnabled() const { return m_base != nullptr; }
+
+    void* Allocate(size_t size)
+    {
+        if (!t_owner)
+        {
+            return std::malloc(size ? size : 1);
+        }
+        if (size > kMaxSize)
+        {
+            ++m_large;
+            return std::malloc(size);
+        }
+        uint32_t cls = size == 0 ? 0 : (size - 1) / kGranule;
+        FreeBlock* block = m_free[cls];
+        if (!block)
+        {
+            block = Refill(cls);
+            if (!block)
+            {
+                ++m_exhausted;
+                return std::malloc(size ? size : 1);
+            }
+        }
+        m_free[cls] = block->next;
+
+        ClassStats& st = m_stats[cls];
+        ++st.allocations;
+        st.peakLive = std::max(st.peakLive, ++st.live);
+        m_bytesInUse += (cls + 1) * kGranule;
+        m_peakBytes = std::max(m_peakBytes, m_bytesInUse);
+        return block;
+    }
+
+    void Free(void* p)
+    {
+        if (!Owns(p))
+        {
+            std::free(p);
+            return;
+        }
+        uint32_t cls = m_pageClass[(static_cast<char*>(p) - m_base) / kPageSize];
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        if (!t_owner)
+        {
+            Lock();
+            block->next = m_remote[cls];
+            m_remote[cls] = block;
+            Unlock();
+            return;
+        }
+        block->next = m_free[cls];
+        m_free[cls] = block;
+        --m_stats[cls].live;
+        m_bytesInUse -= (cls + 1) * kGranule;
+    }
+
+    bool Owns(const void* p) const
+    {
+        return m_base != nullptr && reinterpret_cast<uintptr_t>(p) -
+                                        reinterpret_cast<uintptr_t>(m_base) < kRegionSize;
+    }
+
+    uint64_t GetBytesInUse() const { return m_bytesInUse; }
+
+    /// Bloco ARENA DE ALOCACAO: totais e as classes mais usadas.
+    void Print(std::ostream& os) const
+    {
+        uint64_t allocations = 0;
+        uint32_t top[kClasses];
+        for (uint32_t c = 0; c < kClasses; ++c)
+        {
+            allocations += m_stats[c].allocations;
+            top[c] = c;
+        }
+        std::partial_sort(top, top + 3, top + kClasses, [this](uint32_t a, uint32_t b) {
+            return m_stats[a].allocations > m_stats[b].allocations;
+        });
+        os << "================ ARENA DE ALOCACAO ================" << std::endl;
+        os << "Alocacoes na arena:        " << allocations << std::endl;
+        os << "Alocacoes > 1 KB (malloc): " << m_large << std::endl;
+        os << "Regiao esgotada (malloc):  " << m_exhausted << std::endl;
+        os << "Em uso no fim (MB):        " << m_bytesInUse / 1e6 << std::endl;
+        os << "Pico em uso (MB):          " << m_peakBytes / 1e6 << std::endl;
+        os << "Paginas reservadas (MB):   " << m_pagesUsed * kPageSize / 1e6 << std::endl;
+        for (uint32_t t = 0; t < 3; ++t)
+        {
+            const ClassStats& st = m_stats[top[t]];
+            if (st.allocations == 0)
+            {
+                break;
+            }
+            std::string label = "Classe " + std::to_string((top[t] + 1) * kGranule) + " B:";
+            label.resize(27, ' ');
+            os << label << st.allocations << " alocacoes, pico " << st.peakLive << std::endl;
+        }
+        os << "===================================================" << std::endl;
+    }
+
+  private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    /// Lista da classe vazia: recupera os blocos liberados por outras
+    /// threads ou corta uma página nova em blocos.
+    FreeBlock* Refill(uint32_t cls)
+    {
+        Lock();
+        FreeBlock* remote = m_remote[cls];
+        m_remote[cls] = nullptr;
+        Unlock();
+        if (remote)
+        {
+            for (FreeBlock* b = remote; b; b = b->next)
+            {
+                --m_stats[cls].live;
+                m_bytesInUse -= (cls + 1) * kGranule;
+            }
+            return remote;
+        }
+
+        if ((m_pagesUsed + 1) * kPageSize > kRegionSize)
+        {
+            return nullptr;
+        }
+        char* page = m_base + m_pagesUsed * kPageSize;
+        m_pageClass[m_pagesUsed++] = cls;
+        size_t blockSize = (cls + 1) * kGranule;
+        FreeBlock* head = nullptr;
+        for (size_t off = kPageSize / blockSize * blockSize; off >= blockSize; off -= blockSize)
+        {
+            FreeBlock* b = reinterpret_cast<FreeBlock*>(page + off - blockSize);
+            b->next = head;
+            head = b;
+        }
+        return head;
+    }
+
+    void Lock()
+    {
+        while (m_lock.test_and_set(std::memory_order_acquire))
+        {
+        }
+    }
+
+    void Unlock()
+    {
+        m_lock.clear(std::memory_order_release);
+    }
+
+    char* m_base = nullptr;
+    uint8_t* m_pageClass = nullptr;
+    uint64_t m_pagesUsed = 0;
+    FreeBlock* m_free[kClasses] = {};
+    FreeBlock* m_remote[kClasses] = {};
+    ClassStats m_stats[kClasses] = {};
+    uint64_t m_large = 0;     // pedidos acima de kMaxSize
+    uint64_t m_exhausted = 0; // sem página livre na região
+    uint64_t m_bytesInUse = 0;
+    uint64_t m_peakBytes = 0;
+    std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+
+    // Inicialização constante: pronta antes de qualquer new do programa,
+    // inclusive dos construtores estáticos do ns-3
+    static SmallObjectArena s_arena;
+    static inline thread_local bool t_owner = false;
+};
+
+inline SmallObjectArena SmallObjectArena::s_arena;
+
+} // namespace ns3
+
+/// Com -DCELLULAR_CITY_PACKET_ARENA, substitui o operator new/delete do
+/// programa pela arena (desligada até SmallObjectArena::Get().Enable()); sem
+/// a definição, não faz nada. Usar uma vez, fora de funções, no .cc.
+#ifndef CELLULAR_CITY_PACKET_ARENA
+#define CELLULAR_CITY_ARENA_OPERATORS
+#else
+#define CELLULAR_CITY_ARENA_OPERATORS                                                  \
+    void* operator new(std::size_t size)                                              \
+    {                                                                                  \
+        void* p = ns3::SmallObjectArena::Get().Allocate(size);                         \
+        if (!p)                                                                        \
+        {                                                                              \
+            throw std::bad_alloc();                                                    \
+        }                                                                              \
+        return p;                                                                      \
+    }                                                                                  \
+    void* operator new[](std::size_t size)                                            \
+    {                                                                                  \
+        return operator new(size);                                                     \
+    }                                                                                  \
+    void* operator new(std::size_t size, const std::nothrow_t&) noexcept              \
+    {                                                                                  \
+        return ns3::SmallObjectArena::Get().Allocate(size);                            \
+    }                                                                                  \
+    void* operator new[](std::size_t size, const std::nothrow_t&) noexcept            \
+    {                                                                                  \
+        return ns3::SmallObjectArena::Get().Allocate(size);                            \
+    }                                                                                  \
+    void operator delete(void* p) noexcept                                             \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }                                                                                  \
+    void operator delete[](void* p) noexcept                                           \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }                                                                                  \
+    void operator delete(void* p, std::size_t) noexcept                                \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }                                                                                  \
+    void operator delete[](void* p, std::size_t) noexcept                              \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }                                                                                  \
+    void operator delete(void* p, const std::nothrow_t&) noexcept                      \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }                                                                                  \
+    void operator delete[](void* p, const std::nothrow_t&) noexcept                    \
+    {                                                                                  \
+        ns3::SmallObjectArena::Get().Free(p);                                          \
+    }
+#endif
+
+#endif /* CELLULAR_CITY_ARENA_H */
@@ -0,0 +1,146 @@
+/*
+ * cellular_city_attach.h
+ *
+ * Arquivo de associação da simulação multi-célula (--saveAttach /
+ * --loadAttach): guarda, depois da fase de associação, a posição de cada UE,
+ * a célula servidora (índice na grade de eNodeBs), o endereço IPv4
+ * atribuído pelo EPC e o índice global do UE (a chave dos seus streams com
+ * --fixedStreams). Uma execução seguinte pode partir desse estado: os
+ * UEs são criados nas mesmas posições e associados diretamente à célula
+ * gravada, sem a busca de célula, e os endereços são conferidos. A conexão
+ * RRC e o registro no EPC continuam sendo feitos pela simulação; só a
+ * escolha da célula é pulada.
+ *
+ * Formato binário (versão 3, little-endian):
+ *
+ *   char    magic[8]   "CCATTACH"
+ *   uint32  version    3
+ *   uint32  nUes       registros deste arquivo (UEs do bloco)
+ *   uint32  nEnbs      células (sites da grade x setores x portadoras)
+ *   uint32  totalUes   --nUes da gravação (UEs de todos os blocos)
+ *   double  areaSize   m
+ *   nUes registros de 40 bytes:
+ *     double x, y, z   m
+ *     uint32 cell      site * células por site + setor * portadoras +
+ *                      portadora (kNoCell: UE sem célula)
+ *     uint32 address   IPv4 do UE
+ *     uint64 key       índice global do UE
+ */
+
+#ifndef CELLULAR_CITY_ATTACH_H
+#define CELLULAR_CITY_ATTACH_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+struct AttachRecord
+{
+    static constexpr uint32_t kNoCell = 0xFFFFFFFF;
+
+    Vector position;
+    uint32_t cell;
+    uint32_t address;
+    uint64_t key;
+};
+
+namespace attachfile
+{
+
+constexpr char kMagic[8] = {'C', 'C', 'A', 'T', 'T', 'A', 'C', 'H'};
+constexpr uint32_t kVersion = 3;
+
+template <typename T>
+void
+Put(std::ofstream& os, T value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T
+Get(std::ifstream& is)
+{
+    T value{};
+    is.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
+
+} // namespace attachfile
+
+inline void
+SaveAttachFile(const std::string& path,
+               uint32_t nEnbs,
+               uint32_t totalUes,
+               double areaSize,
+               const std::vector<AttachRecord>& records)
+{
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!os, "Não foi possível criar " << path);
+
+    os.write(attachfile::kMagic, sizeof(attachfile::kMagic));
+    attachfile::Put<uint32_t>(os, attachfile::kVersion);
+    attachfile::Put<uint32_t>(os, records.size());
+    attachfile::Put<uint32_t>(os, nEnbs);
+    attachfile::Put<uint32_t>(os, totalUes);
+    attachfile::Put<double>(os, areaSize);
+    for (const AttachRecord& r : records)
+    {
+        attachfile::Put<double>(os, r.position.x);
+        attachfile::Put<double>(os, r.position.y);
+        attachfile::Put<double>(os, r.position.z);
+        attachfile::Put<uint32_t>(os, r.cell);
+        attachfile::Put<uint32_t>(os, r.address);
+        attachfile::Put<uint64_t>(os, r.key);
+    }
+    NS_ABORT_MSG_IF(!os, "Erro de escrita em " << path);
+}
+
+/// Lê o arquivo e confere que foi gravado com a mesma grade (nEnbs e
+/// areaSize) e o mesmo número de UEs (totalUes) da execução atual.
+inline std::vector<AttachRecord>
+LoadAttachFile(const std::string& path, uint32_t nEnbs, uint32_t totalUes, double areaSize)
+{
+    std::ifstream is(path, std::ios::binary);
+    NS_ABORT_MSG_IF(!is, "Não foi possível abrir " << path);
+
+    char magic[8];
+    is.read(magic, sizeof(magic));
+    NS_ABORT_MSG_IF(!is || std::memcmp(magic, attachfile::kMagic, sizeof(magic)) != 0,
+                    path << " não é um arquivo de associação");
+    uint32_t version = attachfile::Get<uint32_t>(is);
+    NS_ABORT_MSG_IF(version != attachfile::kVersion,
+                    path << ": versão " << version << " não suportada");
+    uint32_t nUes = attachfile::Get<uint32_t>(is);
+    uint32_t fileEnbs = attachfile::Get<uint32_t>(is);
+    uint32_t fileTotal = attachfile::Get<uint32_t>(is);
+    double fileArea = attachfile::Get<double>(is);
+    NS_ABORT_MSG_IF(fileEnbs != nEnbs || fileArea != areaSize,
+                    path << " foi gravado com nEnbs=" << fileEnbs << " e areaSize=" << fileArea);
+    NS_ABORT_MSG_IF(fileTotal != totalUes, path << " foi gravado com nUes=" << fileTotal);
+
+    std::vector<AttachRecord> records(nUes);
+    for (AttachRecord& r : records)
+    {
+        r.position.x = attachfile::Get<double>(is);
+        r.position.y = attachfile::Get<double>(is);
+        r.position.z = attachfile::Get<double>(is);
+        r.cell = attachfile::Get<uint32_t>(is);
+        r.address = attachfile::Get<uint32_t>(is);
+        r.key = attachfile::Get<uint64_t>(is);
+    }
+    NS_ABORT_MSG_IF(!is, path << " truncado");
+    return records;
+}
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_ATTACH_H */
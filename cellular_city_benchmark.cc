@@ -0,0 +1,308 @@
+/*
+ * cellular_city_benchmark.cc
+ *
+ * Benchmark do custo das simulações da cidade: executa um conjunto fixo de
+ * cenários canônicos, um de cada vez, e registra para cada um o tempo de
+ * relógio por fase da montagem, o tempo de Simulator::Run(), os eventos
+ * processados, eventos por segundo e o pico de memória residente. A saída
+ * é gravada em JSON e CSV para comparar versões e opções de otimização.
+ *
+ * Cenários:
+ *   single-50        cellular_city_sim, 50 UEs
+ *   multi-200-7      cellular_city_multicell_sim, 200 UEs, 7 eNodeBs, 2 km
+ *   multi-10k-30     cellular_city_multicell_sim, 10000 UEs, 30 eNodeBs, 6 km
+ *   multi-50k-120    cellular_city_multicell_sim, 50000 UEs, 120 eNodeBs, 20 km
+ *                    (o caso de 500k UEs / 120 eNodeBs com 1/10 dos UEs)
+ *
+ * Exemplo de uso (a partir da pasta build/):
+ *
+ *   ./ns3.cellular_city_benchmark --simTime=10 --output=bench.json
+ *   ./ns3.cellular_city_benchmark --only=multi-10k-30 --multicellArgs="--scheduler=wheel"
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "ns3/core-module.h"
+
+#include "cellular_city_runner.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("CellularCityBenchmark");
+
+namespace
+{
+
+struct Scenario
+{
+    std::string name;
+    std::string program; // nome do binário, sem a pasta
+    std::string args;
+    bool multicell;
+};
+
+const std::vector<Scenario> kScenarios = {
+    {"single-50", "ns3.cellular_city_sim", "--nUes=50", false},
+    {"multi-200-7", "ns3.cellular_city_multicell_sim",
+     "--nUes=200 --nEnbs=7 --areaSize=2000", true},
+    {"multi-10k-30", "ns3.cellular_city_multicell_sim",
+     "--nUes=10000 --nEnbs=30 --areaSize=6000", true},
+    {"multi-50k-120", "ns3.cellular_city_multicell_sim",
+     "--nUes=50000 --nEnbs=120 --areaSize=20000", true},
+};
+
+// Medidas de uma execução de um cenário.
+struct BenchmarkRun
+{
+    std::string scenario;
+    uint32_t repetition;
+    std::vector<std::string> args;
+    std::string status;
+    double wallSeconds = 0.0;
+    long maxRssKb = 0;
+    std::string events;        // "Eventos processados"
+    std::string eventsPerSec;  // "Eventos por segundo"
+    std::string runSeconds;    // "Tempo de execucao (s)"
+    std::vector<std::pair<std::string, std::string>> phases; // TEMPO DE INICIALIZACAO
+};
+
+std::vector<std::string>
+SplitArgs(const std::string& s)
+{
+    std::vector<std::string> out;
+    std::istringstream in(s);
+    std::string arg;
+    while (in >> arg)
+    {
+        out.push_back(arg);
+    }
+    return out;
+}
+
+std::string
+JsonQuote(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Valor numérico no JSON; vazio (execução sem o bloco) vira null.
+std::string
+JsonNumber(const std::string& s)
+{
+    return s.empty() ? "null" : s;
+}
+
+void
+ReadMeasures(const std::string& outPath, BenchmarkRun& run)
+{
+    for (const SummaryLine& line : ReadSummaryBlocks(outPath))
+    {
+        if (line.block.find("INICIALIZACAO") != std::string::npos)
+        {
+            run.phases.emplace_back(line.label, line.value);
+        }
+        else if (line.label == "Eventos processados")
+        {
+            run.events = line.value;
+        }
+        else if (line.label == "Eventos por segundo")
+        {
+            run.eventsPerSec = line.value;
+        }
+        else if (line.label == "Tempo de execucao (s)")
+        {
+            run.runSeconds = line.value;
+        }
+    }
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    std::string programDir    = ".";
+    std::string output        = "benchmark_results.json";
+    std::string csvOutput     = "benchmark_results.csv";
+    std::string workDir       = "benchmark_runs";
+    std::string only;
+    std::string extraArgs;
+    std::string multicellArgs;
+    double      simTime       = 10.0;
+    uint32_t    repeat        = 1;
+
+    CommandLine cmd;
+    cmd.AddValue("programDir", "Pasta com os binários das simulações", programDir);
+    cmd.AddValue("output", "Resultados em JSON", output);
+    cmd.AddValue("csv", "Resultados em CSV", csvOutput);
+    cmd.AddValue("workDir", "Pasta para a saída de cada execução", workDir);
+    cmd.AddValue("only", "Executar só os cenários listados (separados por vírgula)", only);
+    cmd.AddValue("extraArgs", "Argumentos extras para todos os cenários", extraArgs);
+    cmd.AddValue("multicellArgs", "Argumentos extras só para os cenários multi-célula",
+                 multicellArgs);
+    cmd.AddValue("simTime", "Tempo simulado de cada cenário (s)", simTime);
+    cmd.AddValue("repeat", "Repetições de cada cenário", repeat);
+    cmd.Parse(argc, argv);
+
+    mkdir(workDir.c_str(), 0755);
+
+    std::vector<BenchmarkRun> runs;
+    for (const Scenario& sc : kScenarios)
+    {
+        if (!only.empty() && ("," + only + ",").find("," + sc.name + ",") == std::string::npos)
+        {
+            continue;
+        }
+        for (uint32_t rep = 0; rep < repeat; ++rep)
+        {
+            BenchmarkRun run;
+            run.scenario = sc.name;
+            run.repetition = rep;
+            run.args.push_back(programDir + "/" + sc.program);
+            for (const std::string& a : SplitArgs(sc.args))
+            {
+                run.args.push_back(a);
+            }
+            run.args.push_back("--simTime=" + std::to_string(simTime));
+            run.args.push_back("--verbose=false");
+            run.args.push_back("--RngRun=" + std::to_string(rep + 1));
+            for (const std::string& a : SplitArgs(extraArgs))
+            {
+                run.args.push_back(a);
+            }
+            if (sc.multicell)
+            {
+                for (const std::string& a : SplitArgs(multicellArgs))
+                {
+                    run.args.push_back(a);
+                }
+            }
+            runs.push_back(run);
+        }
+    }
+    NS_ABORT_MSG_IF(runs.empty(), "Nenhum cenário selecionado com --only=" << only);
+
+    // Um cenário de cada vez, para que as medidas não disputem a máquina
+    using Clock = std::chrono::steady_clock;
+    for (uint32_t i = 0; i < runs.size(); ++i)
+    {
+        BenchmarkRun& run = runs[i];
+        std::string outPath =
+            workDir + "/" + run.scenario + "-" + std::to_string(run.repetition) + ".out";
+
+        Clock::time_point start = Clock::now();
+        pid_t pid = LaunchProcess(run.args, outPath);
+        ChildExit child = WaitAnyProcess();
+        while (child.pid != pid)
+        {
+            child = WaitAnyProcess();
+        }
+        run.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        run.status = DescribeExit(child.status);
+        run.maxRssKb = child.maxRssKb;
+        ReadMeasures(outPath, run);
+
+        std::cout << "[" << i + 1 << "/" << runs.size() << "] " << run.scenario << ": "
+                  << run.status << ", " << run.wallSeconds << " s, " << run.maxRssKb / 1024
+                  << " MB, " << (run.eventsPerSec.empty() ? "?" : run.eventsPerSec)
+                  << " eventos/s" << std::endl;
+    }
+
+    std::ofstream json(output);
+    NS_ABORT_MSG_IF(!json, "Não foi possível criar " << output);
+    json << "{\n  \"simTime\": " << simTime << ",\n  \"runs\": [\n";
+    for (uint32_t i = 0; i < runs.size(); ++i)
+    {
+        const BenchmarkRun& run = runs[i];
+        json << "    {\n";
+        json << "      \"scenario\": " << JsonQuote(run.scenario) << ",\n";
+        json << "      \"repetition\": " << run.repetition << ",\n";
+        json << "      \"args\": [";
+        for (uint32_t a = 0; a < run.args.size(); ++a)
+        {
+            json << (a > 0 ? ", " : "") << JsonQuote(run.args[a]);
+        }
+        json << "],\n";
+        json << "      \"status\": " << JsonQuote(run.status) << ",\n";
+        json << "      \"wallSeconds\": " << run.wallSeconds << ",\n";
+        json << "      \"runSeconds\": " << JsonNumber(run.runSeconds) << ",\n";
+        json << "      \"events\": " << JsonNumber(run.events) << ",\n";
+        json << "      \"eventsPerSecond\": " << JsonNumber(run.eventsPerSec) << ",\n";
+        json << "      \"peakRssKb\": " << run.maxRssKb << ",\n";
+        json << "      \"phases\": {";
+        for (uint32_t p = 0; p < run.phases.size(); ++p)
+        {
+            json << (p > 0 ? ", " : "") << JsonQuote(run.phases[p].first) << ": "
+                 << JsonNumber(run.phases[p].second);
+        }
+        json << "}\n";
+        json << "    }" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+
+    // CSV: uma linha por execução; as fases viram colunas (união, em ordem)
+    std::vector<std::string> phaseColumns;
+    for (const BenchmarkRun& run : runs)
+    {
+        for (const auto& p : run.phases)
+        {
+            if (std::find(phaseColumns.begin(), phaseColumns.end(), p.first) ==
+                phaseColumns.end())
+            {
+                phaseColumns.push_back(p.first);
+            }
+        }
+    }
+
+    std::ofstream csv(csvOutput);
+    NS_ABORT_MSG_IF(!csv, "Não foi possível criar " << csvOutput);
+    csv << "scenario,repetition,status,wallTime_s,runTime_s,events,eventsPerSecond,peakRss_kB";
+    for (const std::string& c : phaseColumns)
+    {
+        csv << ",\"" << c << "\"";
+    }
+    csv << "\n";
+
+    uint32_t failed = 0;
+    for (const BenchmarkRun& run : runs)
+    {
+        csv << run.scenario << "," << run.repetition << "," << run.status << ","
+            << run.wallSeconds << "," << run.runSeconds << "," << run.events << ","
+            << run.eventsPerSec << "," << run.maxRssKb;
+        for (const std::string& c : phaseColumns)
+        {
+            std::string value;
+            for (const auto& p : run.phases)
+            {
+                if (p.first == c)
+                {
+                    value = p.second;
+                }
+            }
+            csv << "," << value;
+        }
+        csv << "\n";
+        failed += (run.status != "ok");
+    }
+
+    std::cout << "Resultados em " << output << " e " << csvOutput << " (" << failed
+              << " falhas)" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
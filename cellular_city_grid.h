@@ -0,0 +1,513 @@
+/*
+ * cellular_city_grid.h
+ *
+ * Grade regular de eNodeBs usada pela simulação multi-célula (seção 3.1),
+ * ou sites em posições dadas por um cenário (--scenario), e particionamento
+ * dessa grade em blocos geográficos (tiles).
+ */
+
+#ifndef CELLULAR_CITY_GRID_H
+#define CELLULAR_CITY_GRID_H
+
+#include "ns3/abort.h"
+#include "ns3/vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Grade de nRows x nCols posições sobre um quadrado de lado areaSize
+ * centrado na origem. As células são numeradas linha a linha; a última
+ * linha pode ficar incompleta quando nCells não é múltiplo de nCols. Com
+ * SetSites(), as posições são as dadas e as buscas usam um índice de baldes
+ * quadrados (cerca de dois sites por balde) sobre o retângulo dos sites,
+ * examinado em anéis a partir do balde do ponto.
+ */
+class CellGrid
+{
+  public:
+    CellGrid(uint16_t nCells, double areaSize, double height = 30.0)
+        : m_nCells(nCells),
+          m_height(height)
+    {
+        m_nRows = std::floor(std::sqrt(nCells));
+        if (m_nRows == 0)
+        {
+            m_nRows = 1;
+        }
+        m_nCols = std::ceil(static_cast<double>(nCells) / m_nRows);
+
+        m_half = areaSize / 2.0;
+        m_dx = areaSize / (m_nCols + 1);
+        m_dy = areaSize / (m_nRows + 1);
+    }
+
+    /**
+     * Sites em posições dadas (cenário lido de arquivo), no lugar da grade
+     * regular; azimuths[i] é a direção (graus) do setor 0 do site i. nRows
+     * e nCols continuam os da grade com o mesmo número de células, usados só
+     * na divisão em blocos.
+     */
+    void SetSites(const std::vector<Vector>& positions, const std::vector<double>& azimuths)
+    {
+        NS_ABORT_MSG_IF(positions.size() != m_nCells || azimuths.size() != m_nCells,
+                        "O cenário tem " << positions.size() << " sites; a grade tem "
+                                         << m_nCells);
+        m_sites = positions;
+        m_azimuths = azimuths;
+        BuildBuckets();
+    }
+
+    bool HasExplicitSites() const { return !m_sites.empty(); }
+
+    uint16_t GetNCells() const { return m_nCells; }
+    uint16_t GetNRows() const { return m_nRows; }
+    uint16_t GetNCols() const { return m_nCols; }
+    double GetDx() const { return m_dx; }
+    double GetDy() const { return m_dy; }
+    double GetAreaSize() const { return 2.0 * m_half; }
+
+    /// Direção (graus) do setor 0 do site.
+    double GetAzimuth(uint16_t cell) const
+    {
+        return m_azimuths.empty() ? 0.0 : m_azimuths[cell];
+    }
+
+    uint16_t GetRow(uint16_t cell) const { return cell / m_nCols; }
+    uint16_t GetCol(uint16_t cell) const { return cell % m_nCols; }
+
+    Vector GetPosition(uint16_t cell) const
+    {
+        if (!m_sites.empty())
+        {
+            return m_sites[cell];
+        }
+        double x = -m_half + (GetCol(cell) + 1) * m_dx;
+        double y = -m_half + (GetRow(cell) + 1) * m_dy;
+        return Vector(x, y, m_height);
+    }
+
+    /**
+     * eNodeB mais próximo de (x, y). Como a grade é regular, basta olhar a
+     * vizinhança 3x3 do ponto arredondado, limitando a coluna ao trecho
+     * preenchido de cada linha (a última pode ser incompleta).
+     */
+    uint16_t FindNearest(double x, double y) const
+    {
+        if (!m_sites.empty())
+        {
+            return FindNearestSite(x, y);
+        }
+        int r0 = ClampIndex(std::lround((y + m_half) / m_dy) - 1, m_nRows);
+        int c0 = ClampIndex(std::lround((x + m_half) / m_dx) - 1, m_nCols);
+
+        uint16_t best = 0;
+        double bestDist = std::numeric_limits<double>::max();
+        for (int r = r0 - 1; r <= r0 + 1; ++r)
+        {
+            if (r < 0 || r >= m_nRows)
+            {
+                continue;
+            }
+            int lastCol = std::min<int>(m_nCols, m_nCells - r * m_nCols) - 1;
+            for (int c = c0 - 1; c <= c0 + 1; ++c)
+            {
+                uint16_t cell = r * m_nCols + std::clamp(c, 0, lastCol);
+                Vector p = GetPosition(cell);
+                double d = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+                if (d < bestDist)
+                {
+                    bestDist = d;
+                    best = cell;
+                }
+            }
+        }
+        return best;
+    }
+
+    /// Células adjacentes na grade (até 8: linha, coluna e diagonais); com
+    /// SetSites(), os 8 sites mais próximos.
+    std::vector<uint16_t> GetNeighbours(uint16_t cell) const
+    {
+        if (!m_sites.empty())
+        {
+            return NearestSites(cell, 8);
+        }
+        std::vector<uint16_t> neighbours;
+        int row = GetRow(cell);
+        int col = GetCol(cell);
+        for (int r = row - 1; r <= row + 1; ++r)
+        {
+            for (int c = col - 1; c <= col + 1; ++c)
+            {
+                if (r < 0 || r >= m_nRows || c < 0 || c >= m_nCols || (r == row && c == col))
+                {
+                    continue;
+                }
+                int other = r * m_nCols + c;
+                if (other < m_nCells)
+                {
+                    neighbours.push_back(other);
+                }
+            }
+        }
+        return neighbours;
+    }
+
+    /**
+     * Distância de (x, y) até a borda da célula de Voronoi do eNodeB mais
+     * próximo, isto é, até a mediatriz mais próxima entre ele e outro
+     * eNodeB. Examina todas as células, porque com a última linha incompleta
+     * a vizinha mais próxima pode estar longe na grade.
+     */
+    double DistanceToBorder(double x, double y) const
+    {
+        Vector s = GetPosition(FindNearest(x, y));
+        double ds = (s.x - x) * (s.x - x) + (s.y - y) * (s.y - y);
+        double best = std::numeric_limits<double>::max();
+        for (uint16_t j = 0; j < m_nCells; ++j)
+        {
+            Vector o = GetPosition(j);
+            double sep = std::hypot(o.x - s.x, o.y - s.y);
+            if (sep == 0.0)
+            {
+                continue;
+            }
+            double dj = (o.x - x) * (o.x - x) + (o.y - y) * (o.y - y);
+            best = std::min(best, (dj - ds) / (2.0 * sep));
+        }
+        return best;
+    }
+
+    /**
+     * Setor de um site com nSectors setores (antenas apontadas para 0,
+     * 360/nSectors, ... graus a partir do eixo x) cuja direção de máximo
+     * ganho está mais perto do azimute de (x, y) visto do site.
+     */
+    uint16_t FindSector(uint16_t cell, double x, double y, uint16_t nSectors) const
+    {
+        if (nSectors <= 1)
+        {
+            return 0;
+        }
+        Vector s = GetPosition(cell);
+        double azimuth = std::atan2(y - s.y, x - s.x) * 180.0 / M_PI - GetAzimuth(cell);
+        azimuth = std::fmod(azimuth, 360.0);
+        if (azimuth < 0)
+        {
+            azimuth += 360.0;
+        }
+        double width = 360.0 / nSectors;
+        return static_cast<uint16_t>(std::lround(azimuth / width)) % nSectors;
+    }
+
+  private:
+    static int ClampIndex(long v, uint16_t n)
+    {
+        return static_cast<int>(std::clamp<long>(v, 0, n - 1));
+    }
+
+    /// Baldes de lado m_bucketSize sobre o retângulo dos sites, com os
+    /// sites de cada balde contíguos em m_bucketSites (linha a linha).
+    void BuildBuckets()
+    {
+        double maxX = m_sites[0].x;
+        double maxY = m_sites[0].y;
+        m_minX = m_sites[0].x;
+        m_minY = m_sites[0].y;
+        for (const Vector& s : m_sites)
+        {
+            m_minX = std::min(m_minX, s.x);
+            m_minY = std::min(m_minY, s.y);
+            maxX = std::max(maxX, s.x);
+            maxY = std::max(maxY, s.y);
+        }
+        double width = std::max(maxX - m_minX, 1.0);
+        double height = std::max(maxY - m_minY, 1.0);
+        m_bucketSize = std::sqrt(width * height * 2.0 / m_nCells);
+        m_bucketCols = std::clamp<long>(std::ceil(width / m_bucketSize), 1, 1024);
+        m_bucketRows = std::clamp<long>(std::ceil(height / m_bucketSize), 1, 1024);
+
+        std::vector<uint32_t> bucketOf(m_nCells);
+        m_bucketStart.assign(m_bucketRows * m_bucketCols + 1, 0);
+        for (uint16_t cell = 0; cell < m_nCells; ++cell)
+        {
+            bucketOf[cell] = BucketRow(m_sites[cell].y) * m_bucketCols + BucketCol(m_sites[cell].x);
+            ++m_bucketStart[bucketOf[cell] + 1];
+        }
+        for (uint32_t b = 0; b + 1 < m_bucketStart.size(); ++b)
+        {
+            m_bucketStart[b + 1] += m_bucketStart[b];
+        }
+        std::vector<uint32_t> next(m_bucketStart.begin(), m_bucketStart.end() - 1);
+        m_bucketSites.resize(m_nCells);
+        for (uint16_t cell = 0; cell < m_nCells; ++cell)
+        {
+            m_bucketSites[next[bucketOf[cell]]++] = cell;
+        }
+    }
+
+    int BucketCol(double x) const
+    {
+        return ClampIndex(std::floor((x - m_minX) / m_bucketSize), m_bucketCols);
+    }
+
+    int BucketRow(double y) const
+    {
+        return ClampIndex(std::floor((y - m_minY) / m_bucketSize), m_bucketRows);
+    }
+
+    /**
+     * Visita os sites em anéis quadrados de baldes em torno do balde de
+     * (x, y), do anel 0 para fora, chamando visit(site) para cada um. Depois
+     * de cada anel chama done(bound), com bound a menor distância possível
+     * de (x, y) a um site ainda não visitado, e para quando ela devolve true
+     * ou não restam baldes.
+     */
+    template <typename Visit, typename Done>
+    void SearchBuckets(double x, double y, Visit visit, Done done) const
+    {
+        int col = BucketCol(x);
+        int row = BucketRow(y);
+        for (int r = 0;; ++r)
+        {
+            for (int br = row - r; br <= row + r; ++br)
+            {
+                if (br < 0 || br >= m_bucketRows)
+                {
+                    continue;
+                }
+                // Nas linhas internas do anel, só as duas colunas da borda
+                int step = (br == row - r || br == row + r) ? 1 : std::max(2 * r, 1);
+                for (int bc = col - r; bc <= col + r; bc += step)
+                {
+                    if (bc < 0 || bc >= m_bucketCols)
+                    {
+                        continue;
+                    }
+                    uint32_t b = br * m_bucketCols + bc;
+                    for (uint32_t i = m_bucketStart[b]; i < m_bucketStart[b + 1]; ++i)
+                    {
+                        visit(m_bucketSites[i]);
+                    }
+                }
+            }
+
+            // Lados do quadrado visitado que ainda têm baldes além deles
+            double bound = std::numeric_limits<double>::max();
+            bool more = false;
+            if (col - r > 0)
+            {
+                bound = std::min(bound, x - (m_minX + (col - r) * m_bucketSize));
+                more = true;
+            }
+            if (col + r < m_bucketCols - 1)
+            {
+                bound = std::min(bound, m_minX + (col + r + 1) * m_bucketSize - x);
+                more = true;
+            }
+            if (row - r > 0)
+            {
+                bound = std::min(bound, y - (m_minY + (row - r) * m_bucketSize));
+                more = true;
+            }
+            if (row + r < m_bucketRows - 1)
+            {
+                bound = std::min(bound, m_minY + (row + r + 1) * m_bucketSize - y);
+                more = true;
+            }
+            if (!more || done(std::max(bound, 0.0)))
+            {
+                return;
+            }
+        }
+    }
+
+    /// Site mais próximo; no empate, o de menor índice (como uma varredura
+    /// de todos os sites).
+    uint16_t FindNearestSite(double x, double y) const
+    {
+        uint16_t best = 0;
+        double bestDist = std::numeric_limits<double>::max();
+        SearchBuckets(
+            x,
+            y,
+            [&](uint16_t cell) {
+                double d = (m_sites[cell].x - x) * (m_sites[cell].x - x) +
+                           (m_sites[cell].y - y) * (m_sites[cell].y - y);
+                if (d < bestDist || (d == bestDist && cell < best))
+                {
+                    bestDist = d;
+                    best = cell;
+                }
+            },
+            [&](double bound) { return bestDist < bound * bound; });
+        return best;
+    }
+
+    std::vector<uint16_t> NearestSites(uint16_t cell, uint32_t n) const
+    {
+        std::vector<std::pair<double, uint16_t>> byDistance;
+        n = std::min<uint32_t>(n, m_nCells - 1);
+        SearchBuckets(
+            m_sites[cell].x,
+            m_sites[cell].y,
+            [&](uint16_t other) {
+                if (other != cell)
+                {
+                    byDistance.emplace_back(std::hypot(m_sites[other].x - m_sites[cell].x,
+                                                       m_sites[other].y - m_sites[cell].y),
+                                            other);
+                }
+            },
+            [&](double bound) {
+                if (n == 0)
+                {
+                    return true;
+                }
+                if (byDistance.size() < n)
+                {
+                    return false;
+                }
+                std::nth_element(byDistance.begin(), byDistance.begin() + n - 1, byDistance.end());
+                return byDistance[n - 1].first < bound;
+            });
+        n = std::min<uint32_t>(n, byDistance.size());
+        std::partial_sort(byDistance.begin(), byDistance.begin() + n, byDistance.end());
+        std::vector<uint16_t> neighbours;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            neighbours.push_back(byDistance[i].second);
+        }
+        return neighbours;
+    }
+
+    uint16_t m_nCells;
+    uint16_t m_nRows;
+    uint16_t m_nCols;
+    double m_half;
+    double m_dx;
+    double m_dy;
+    double m_height;
+    std::vector<Vector> m_sites;   // vazio: grade regular
+    std::vector<double> m_azimuths;
+    double m_minX = 0.0;           // índice de baldes dos sites
+    double m_minY = 0.0;
+    double m_bucketSize = 1.0;
+    int m_bucketRows = 0;
+    int m_bucketCols = 0;
+    std::vector<uint32_t> m_bucketStart; // sites do balde b: [start[b], start[b + 1])
+    std::vector<uint16_t> m_bucketSites;
+};
+
+/**
+ * Divide a grade em tileRows x tileCols blocos retangulares de células
+ * vizinhas, com tileRows * tileCols == nTiles. A fatoração escolhida é a
+ * que deixa os blocos mais próximos de quadrados. Também aceita um bloco
+ * dado para cada célula (IsCustom()).
+ */
+class GridTiling
+{
+  public:
+    GridTiling(const CellGrid& grid, uint32_t nTiles)
+        : m_grid(grid),
+          m_nTiles(nTiles),
+          m_tileRows(0),
+          m_tileCols(0)
+    {
+        double bestScore = std::numeric_limits<double>::max();
+        for (uint32_t tr = 1; tr <= nTiles; ++tr)
+        {
+            if (nTiles % tr != 0)
+            {
+                continue;
+            }
+            uint32_t tc = nTiles / tr;
+            if (tr > grid.GetNRows() || tc > grid.GetNCols())
+            {
+                continue;
+            }
+            double aspect = (static_cast<double>(grid.GetNRows()) / tr) /
+                            (static_cast<double>(grid.GetNCols()) / tc);
+            double score = std::abs(std::log(aspect));
+            if (score < bestScore)
+            {
+                bestScore = score;
+                m_tileRows = tr;
+                m_tileCols = tc;
+            }
+        }
+        NS_ABORT_MSG_IF(m_tileRows == 0,
+                        "Não é possível dividir a grade " << grid.GetNRows() << "x"
+                                                          << grid.GetNCols() << " em "
+                                                          << nTiles << " blocos");
+    }
+
+    /// Bloco de cada célula dado por cellTiles (um valor em [0, nTiles) por
+    /// célula, todo bloco com pelo menos uma célula).
+    GridTiling(const CellGrid& grid, uint32_t nTiles, const std::vector<uint32_t>& cellTiles)
+        : m_grid(grid),
+          m_nTiles(nTiles),
+          m_tileRows(0),
+          m_tileCols(0),
+          m_cellTiles(cellTiles)
+    {
+        NS_ABORT_MSG_IF(cellTiles.size() != grid.GetNCells(),
+                        "O mapa de blocos tem " << cellTiles.size() << " células; a grade tem "
+                                                << grid.GetNCells());
+        std::vector<bool> used(nTiles, false);
+        for (uint32_t tile : cellTiles)
+        {
+            NS_ABORT_MSG_IF(tile >= nTiles, "Bloco " << tile << " fora de [0, " << nTiles << ")");
+            used[tile] = true;
+        }
+        NS_ABORT_MSG_IF(std::find(used.begin(), used.end(), false) != used.end(),
+                        "Todo bloco precisa de pelo menos uma célula");
+    }
+
+    bool IsCustom() const { return !m_cellTiles.empty(); }
+
+    uint32_t GetNTiles() const { return m_nTiles; }
+    uint32_t GetTileRows() const { return m_tileRows; }
+    uint32_t GetTileCols() const { return m_tileCols; }
+
+    uint32_t GetTile(uint16_t cell) const
+    {
+        if (!m_cellTiles.empty())
+        {
+            return m_cellTiles[cell];
+        }
+        if (m_grid.HasExplicitSites())
+        {
+            // Faixas iguais da área em x e y
+            Vector p = m_grid.GetPosition(cell);
+            double area = m_grid.GetAreaSize();
+            uint32_t tileRow = std::clamp<long>(std::floor((p.y / area + 0.5) * m_tileRows), 0,
+                                                m_tileRows - 1);
+            uint32_t tileCol = std::clamp<long>(std::floor((p.x / area + 0.5) * m_tileCols), 0,
+                                                m_tileCols - 1);
+            return tileRow * m_tileCols + tileCol;
+        }
+        uint32_t tileRow = m_grid.GetRow(cell) * m_tileRows / m_grid.GetNRows();
+        uint32_t tileCol = m_grid.GetCol(cell) * m_tileCols / m_grid.GetNCols();
+        return tileRow * m_tileCols + tileCol;
+    }
+
+  private:
+    CellGrid m_grid;
+    uint32_t m_nTiles;
+    uint32_t m_tileRows;
+    uint32_t m_tileCols;
+    std::vector<uint32_t> m_cellTiles; // vazio: blocos retangulares
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_GRID_H */
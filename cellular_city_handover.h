@@ -0,0 +1,256 @@
+/*
+ * cellular_city_handover.h
+ *
+ * Handover na grade de eNodeBs da simulação multi-célula (--handover). O
+ * LteHelper::AddX2Interface(NodeContainer) liga todos os pares de eNodeBs,
+ * e o ANR monta a relação de vizinhas a partir das medidas contra todas as
+ * células. Aqui a vizinhança vem da grade (seção 3.1): X2 só entre os
+ * eNodeBs de sites adjacentes e entre os setores do mesmo site, na mesma
+ * portadora, e o algoritmo de handover (evento A3 por RSRP, como o
+ * A3RsrpHandoverAlgorithm) só considera as células dessa lista. O custo
+ * cresce com o número de vizinhas, não com nEnbs.
+ */
+
+#ifndef CELLULAR_CITY_HANDOVER_H
+#define CELLULAR_CITY_HANDOVER_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/network-module.h"
+
+#include "cellular_city_grid.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Evento A3 (vizinha melhor que a servidora por Hysteresis dB durante
+ * TimeToTrigger) com destino restrito à lista de SetNeighbours(): a vizinha
+ * de maior RSRP no relatório que está na lista.
+ */
+class GridNeighbourHandoverAlgorithm : public LteHandoverAlgorithm
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid =
+            TypeId("ns3::GridNeighbourHandoverAlgorithm")
+                .SetParent<LteHandoverAlgorithm>()
+                .SetGroupName("Lte")
+                .AddConstructor<GridNeighbourHandoverAlgorithm>()
+                .AddAttribute("Hysteresis",
+                              "Margem (dB) da vizinha sobre a servidora no evento A3.",
+                              DoubleValue(3.0),
+                              MakeDoubleAccessor(&GridNeighbourHandoverAlgorithm::m_hysteresisDb),
+                              MakeDoubleChecker<double>(0.0, 15.0))
+                .AddAttribute("TimeToTrigger",
+                              "Tempo em que a condição do evento A3 deve valer.",
+                              TimeValue(MilliSeconds(256)),
+                              MakeTimeAccessor(&GridNeighbourHandoverAlgorithm::m_timeToTrigger),
+                              MakeTimeChecker());
+        return tid;
+    }
+
+    GridNeighbourHandoverAlgorithm()
+        : m_sapProvider(new MemberLteHandoverManagementSapProvider<GridNeighbourHandoverAlgorithm>(
+              this))
+    {
+    }
+
+    void SetLteHandoverManagementSapUser(LteHandoverManagementSapUser* s) override
+    {
+        m_sapUser = s;
+    }
+
+    LteHandoverManagementSapProvider* GetLteHandoverManagementSapProvider() override
+    {
+        return m_sapProvider;
+    }
+
+    /// Células (cellId) para onde os UEs desta célula podem ir.
+    void SetNeighbours(std::vector<uint16_t> cellIds)
+    {
+        std::sort(cellIds.begin(), cellIds.end());
+        m_neighbours = std::move(cellIds);
+    }
+
+    uint64_t GetTriggeredHandovers() const { return m_triggered; }
+
+  protected:
+    void DoInitialize() override
+    {
+        LteRrcSap::ReportConfigEutra reportConfig;
+        reportConfig.eventId = LteRrcSap::ReportConfigEutra::EVENT_A3;
+        reportConfig.a3Offset = 0;
+        reportConfig.hysteresis = EutranMeasurementMapping::ActualHysteresis2IeValue(m_hysteresisDb);
+        reportConfig.timeToTrigger = m_timeToTrigger.GetMilliSeconds();
+        reportConfig.reportOnLeave = false;
+        reportConfig.triggerQuantity = LteRrcSap::ReportConfigEutra::RSRP;
+        reportConfig.reportInterval = LteRrcSap::ReportConfigEutra::MS1024;
+        m_measIds = m_sapUser->AddUeMeasReportConfigForHandover(reportConfig);
+        LteHandoverAlgorithm::DoInitialize();
+    }
+
+    void DoDispose() override
+    {
+        delete m_sapProvider;
+        m_sapProvider = nullptr;
+        LteHandoverAlgorithm::DoDispose();
+    }
+
+    void DoReportUeMeas(uint16_t rnti, LteRrcSap::MeasResults measResults) override
+    {
+        if (std::find(m_measIds.begin(), m_measIds.end(), measResults.measId) == m_measIds.end() ||
+            !measResults.haveMeasResultNeighCells)
+        {
+            return;
+        }
+        uint16_t bestCell = 0;
+        uint8_t bestRsrp = 0;
+        for (const LteRrcSap::MeasResultEutra& r : measResults.measResultListEutra)
+        {
+            if (r.haveRsrpResult && r.rsrpResult > bestRsrp &&
+                std::binary_search(m_neighbours.begin(), m_neighbours.end(), r.physCellId))
+            {
+                bestCell = r.physCellId;
+                bestRsrp = r.rsrpResult;
+            }
+        }
+        if (bestCell > 0)
+        {
+            ++m_triggered;
+            m_sapUser->TriggerHandover(rnti, bestCell);
+        }
+    }
+
+  private:
+    friend class MemberLteHandoverManagementSapProvider<GridNeighbourHandoverAlgorithm>;
+
+    double m_hysteresisDb = 3.0;
+    Time m_timeToTrigger;
+    std::vector<uint8_t> m_measIds;
+    std::vector<uint16_t> m_neighbours; // ordenadas
+    uint64_t m_triggered = 0;
+
+    LteHandoverManagementSapUser* m_sapUser = nullptr;
+    LteHandoverManagementSapProvider* m_sapProvider;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(GridNeighbourHandoverAlgorithm);
+
+/**
+ * X2 e listas de vizinhas a partir da grade. Os eNodeBs de um site ficam em
+ * sequência em enbDevs, a partir de enbIndex[site] (-1 para sites fora do
+ * bloco deste processo), na ordem (setor, portadora).
+ */
+class GridHandover
+{
+  public:
+    /// Antes de instalar os eNodeBs. Hysteresis e TimeToTrigger seguem os
+    /// padrões de ns3::GridNeighbourHandoverAlgorithm.
+    static void Configure(Ptr<LteHelper> lteHelper)
+    {
+        lteHelper->SetHandoverAlgorithmType("ns3::GridNeighbourHandoverAlgorithm");
+        // A lista da grade substitui a relação de vizinhas do ANR
+        lteHelper->SetAttribute("AnrEnabled", BooleanValue(false));
+    }
+
+    void Connect(Ptr<LteHelper> lteHelper,
+                 const NetDeviceContainer& enbDevs,
+                 const CellGrid& grid,
+                 const std::vector<int32_t>& enbIndex,
+                 uint32_t perSite,
+                 uint32_t carriers)
+    {
+        std::vector<std::vector<uint16_t>> neighbours(enbDevs.GetN());
+        auto link = [&](uint32_t a, uint32_t b) {
+            lteHelper->AddX2Interface(enbDevs.Get(a)->GetNode(), enbDevs.Get(b)->GetNode());
+            neighbours[a].push_back(GetEnb(enbDevs, b)->GetCellId());
+            neighbours[b].push_back(GetEnb(enbDevs, a)->GetCellId());
+            ++m_x2Links;
+        };
+
+        for (uint16_t site = 0; site < grid.GetNCells(); ++site)
+        {
+            if (enbIndex[site] < 0)
+            {
+                continue;
+            }
+            // Cada par de sites uma vez: o próprio site e os adjacentes de
+            // índice maior
+            std::vector<uint16_t> sites{site};
+            for (uint16_t other : grid.GetNeighbours(site))
+            {
+                if (other > site && enbIndex[other] >= 0)
+                {
+                    sites.push_back(other);
+                }
+            }
+            for (uint32_t a = 0; a < perSite; ++a)
+            {
+                for (uint16_t other : sites)
+                {
+                    for (uint32_t b = other == site ? a + 1 : 0; b < perSite; ++b)
+                    {
+                        if (a % carriers == b % carriers)
+                        {
+                            link(enbIndex[site] + a, enbIndex[other] + b);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (uint32_t k = 0; k < enbDevs.GetN(); ++k)
+        {
+            Ptr<LteEnbNetDevice> enb = GetEnb(enbDevs, k);
+            PointerValue algorithm;
+            enb->GetAttribute("LteHandoverAlgorithm", algorithm);
+            Ptr<GridNeighbourHandoverAlgorithm> handover =
+                algorithm.Get<GridNeighbourHandoverAlgorithm>();
+            NS_ABORT_MSG_IF(!handover, "GridHandover::Configure() não foi chamado antes dos eNodeBs");
+            handover->SetNeighbours(neighbours[k]);
+            m_algorithms.push_back(handover);
+            enb->GetRrc()->TraceConnectWithoutContext(
+                "HandoverEndOk",
+                MakeCallback(&GridHandover::HandoverEndOk, this));
+        }
+    }
+
+    uint64_t GetX2Links() const { return m_x2Links; }
+
+    uint64_t GetTriggeredHandovers() const
+    {
+        uint64_t triggered = 0;
+        for (const Ptr<GridNeighbourHandoverAlgorithm>& a : m_algorithms)
+        {
+            triggered += a->GetTriggeredHandovers();
+        }
+        return triggered;
+    }
+
+    uint64_t GetCompletedHandovers() const { return m_completed; }
+
+  private:
+    static Ptr<LteEnbNetDevice> GetEnb(const NetDeviceContainer& enbDevs, uint32_t k)
+    {
+        return enbDevs.Get(k)->GetObject<LteEnbNetDevice>();
+    }
+
+    void HandoverEndOk(uint64_t /* imsi */, uint16_t /* cellId */, uint16_t /* rnti */)
+    {
+        ++m_completed;
+    }
+
+    uint64_t m_x2Links = 0;
+    uint64_t m_completed = 0;
+    std::vector<Ptr<GridNeighbourHandoverAlgorithm>> m_algorithms;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_HANDOVER_H */
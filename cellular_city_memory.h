@@ -0,0 +1,129 @@
+/*
+ * cellular_city_memory.h
+ *
+ * Memória ocupada por componente na montagem das simulações da cidade
+ * (--memReport). Cada Mark() fecha um componente com o crescimento do heap
+ * em uso (mallinfo2 da glibc) desde o Mark() anterior; o resumo divide o
+ * crescimento dos componentes que escalam com os UEs pelo número de UEs. O
+ * pico de RSS vem de getrusage().
+ */
+
+#ifndef CELLULAR_CITY_MEMORY_H
+#define CELLULAR_CITY_MEMORY_H
+
+#include "cellular_city_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+namespace ns3
+{
+
+/// Bytes alocados pelo malloc (0 fora da glibc) e pela arena de objetos
+/// pequenos (--packetArena) e ainda não liberados.
+inline uint64_t
+HeapBytesInUse()
+{
+    uint64_t arena = SmallObjectArena::Get().GetBytesInUse();
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return arena + mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    // mallinfo() usa int e satura acima de 2 GB
+    struct mallinfo mi = mallinfo();
+    return arena + static_cast<uint32_t>(mi.uordblks) + static_cast<uint32_t>(mi.hblkhd);
+#else
+    return arena;
+#endif
+}
+
+/// Pico do conjunto residente do processo, em bytes.
+inline uint64_t
+PeakRssBytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // KB no Linux
+}
+
+class MemoryFootprint
+{
+  public:
+    MemoryFootprint()
+        : m_start(HeapBytesInUse()),
+          m_last(m_start)
+    {
+    }
+
+    /// perUe = false para o que não cresce com o número de UEs (helpers,
+    /// host remoto, eNodeBs).
+    void Mark(const std::string& component, bool perUe = true)
+    {
+        uint64_t now = HeapBytesInUse();
+        m_components.push_back({component, (double)now - (double)m_last, perUe});
+        m_last = now;
+    }
+
+    /**
+     * Bloco MEMORIA POR UE: MB de cada componente fixo e bytes por UE dos
+     * outros (nUes UEs neste processo). Com budgetGb > 0, também quantos UEs
+     * caberiam nesse orçamento.
+     */
+    void Print(std::ostream& os, uint32_t nUes, double budgetGb) const
+    {
+        double perUe = 0.0;
+        double fixed = 0.0;
+        os << "================ MEMORIA POR UE ================" << std::endl;
+        for (const Component& c : m_components)
+        {
+            if (!c.perUe)
+            {
+                fixed += c.bytes;
+                PrintLine(os, c.name + " (MB):", c.bytes / 1e6);
+                continue;
+            }
+            double bytes = nUes > 0 ? c.bytes / nUes : 0.0;
+            perUe += bytes;
+            PrintLine(os, c.name + " (B/UE):", bytes);
+        }
+        PrintLine(os, "Total por UE (B):", perUe);
+        PrintLine(os, "Heap em uso (MB):", ((double)m_last - (double)m_start) / 1e6);
+        PrintLine(os, "Pico RSS (MB):", PeakRssBytes() / 1e6);
+        if (budgetGb > 0 && perUe > 0)
+        {
+            double available = std::max(0.0, budgetGb * 1e9 - fixed);
+            PrintLine(os, "Orcamento (GB):", budgetGb);
+            PrintLine(os, "UEs no orcamento (estimativa):", (uint64_t)(available / perUe));
+        }
+        os << "================================================" << std::endl;
+    }
+
+  private:
+    struct Component
+    {
+        std::string name;
+        double bytes;
+        bool perUe;
+    };
+
+    template <typename T>
+    static void PrintLine(std::ostream& os, std::string label, T value)
+    {
+        label.resize(std::max<size_t>(label.size() + 1, 36), ' ');
+        os << label << value << std::endl;
+    }
+
+    uint64_t m_start;
+    uint64_t m_last;
+    std::vector<Component> m_components;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_MEMORY_H */
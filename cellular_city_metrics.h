@@ -0,0 +1,419 @@
+/*
+ * cellular_city_metrics.h
+ *
+ * Coleta de métricas em fluxo contínuo para as simulações da cidade: os
+ * contadores globais (atraso, jitter, pacotes/bytes recebidos e perdidos) e
+ * histogramas de tamanho fixo são atualizados pelos traces do UdpClient e do
+ * UdpServer durante Simulator::Run(), sem copiar o mapa do FlowMonitor no fim.
+ *
+ * Por fluxo (um por UE, UE -> host remoto) guarda só contadores compactos,
+ * necessários para o jitter e para a perda; histogramas por fluxo ficam a
+ * cargo do FlowMonitor quando pedido com --perFlowStats. A tabela de fluxos
+ * é indexada diretamente pelo índice do fluxo: os contadores atualizados a
+ * cada pacote, a célula e a porta do UE ocupam uma linha de cache por
+ * fluxo, e o endereço, lido só no fim, fica em uma coluna separada. Os endereços
+ * dos UEs, atribuídos em sequência pelo EPC, levam ao fluxo por subtração.
+ *
+ * Contadores correntes por célula (RunningCounters), atualizados a cada
+ * pacote, permitem amostrar a série temporal sem varrer os fluxos.
+ *
+ * Com SetWarmup() os pacotes enviados antes do fim do aquecimento não
+ * entram em nenhum contador nem histograma.
+ *
+ * Um fluxo pode representar vários UEs (SetFlowWeight(), usado pelos
+ * agrupamentos da simulação multi-célula): cada pacote do fluxo conta como
+ * weight pacotes de UE, todos com o atraso do pacote agregado. Os contadores
+ * do fluxo (FlowCounters) continuam por pacote do nó; os totais, os
+ * contadores por célula e os histogramas já vêm ponderados.
+ */
+
+#ifndef CELLULAR_CITY_METRICS_H
+#define CELLULAR_CITY_METRICS_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/seq-ts-header.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Histograma com nBins classes de largura fixa, mais uma classe de estouro
+ * para os valores acima de nBins * binWidth.
+ */
+class FixedHistogram
+{
+  public:
+    FixedHistogram(double binWidth, uint32_t nBins)
+        : m_binWidth(binWidth),
+          m_counts(nBins + 1, 0),
+          m_total(0)
+    {
+    }
+
+    void Add(double value, uint32_t count = 1)
+    {
+        uint32_t bin = std::min<double>(value / m_binWidth, m_counts.size() - 1);
+        m_counts[bin] += count;
+        m_total += count;
+    }
+
+    /// Limite superior da classe que contém o quantil q (0..1).
+    double Quantile(double q) const
+    {
+        if (m_total == 0)
+        {
+            return 0.0;
+        }
+        uint64_t target = std::max<uint64_t>(1, std::ceil(q * m_total));
+        uint64_t acc = 0;
+        for (uint32_t i = 0; i < m_counts.size(); ++i)
+        {
+            acc += m_counts[i];
+            if (acc >= target)
+            {
+                return (i + 1) * m_binWidth;
+            }
+        }
+        return m_counts.size() * m_binWidth;
+    }
+
+    std::vector<uint64_t>& GetCounts() { return m_counts; }
+    const std::vector<uint64_t>& GetCounts() const { return m_counts; }
+
+    void SetCounts(const std::vector<uint64_t>& counts)
+    {
+        m_counts = counts;
+        m_total = 0;
+        for (uint64_t c : counts)
+        {
+            m_total += c;
+        }
+    }
+
+  private:
+    double m_binWidth;
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total;
+};
+
+/**
+ * Métricas acumuladas durante a simulação. Os fluxos são registrados com
+ * AddFlow() na ordem dos UEs; os traces são ligados por ConnectClient() e
+ * ConnectServer().
+ */
+class StreamingMetrics
+{
+  public:
+    /// Bytes de cabeçalho IPv4 + UDP somados a cada pacote recebido, para que
+    /// o throughput seja medido no nível IP, como no FlowMonitor.
+    static constexpr uint32_t kIpUdpHeaderBytes = 28;
+
+    /// Contadores compactos de um fluxo UE -> host remoto, alinhados a uma
+    /// linha de cache: cada pacote enviado ou recebido toca uma só linha,
+    /// junto com a célula dos contadores correntes.
+    struct alignas(64) FlowCounters
+    {
+        uint32_t txPackets = 0;
+        uint32_t rxPackets = 0;
+        uint32_t maxSeq    = 0;
+        uint32_t seqBase   = 0; // pacotes enviados durante o aquecimento
+        uint32_t weight    = 1; // UEs representados pelo fluxo
+        uint32_t cell      = 0; // índice em m_cells
+        uint16_t port      = 0; // porta UDP do UE
+        uint64_t rxBytes   = 0;
+        int64_t  delaySum  = 0; // em unidades de Time (TimeStep)
+        int64_t  jitterSum = 0;
+        int64_t  lastDelay = 0;
+    };
+    static_assert(sizeof(FlowCounters) == 64, "FlowCounters deve ocupar uma linha de cache");
+
+    /// Totais globais; os campos são somáveis entre partições.
+    struct Totals
+    {
+        double   delaySum    = 0.0; // s
+        double   jitterSum   = 0.0; // s
+        uint64_t txPackets   = 0;
+        uint64_t rxPackets   = 0;
+        uint64_t rxBytes     = 0;
+        uint64_t lostPackets = 0;
+    };
+
+    /// Contadores acumulados desde o início, por célula ou globais. As
+    /// perdas são os buracos na sequência detectados até agora.
+    struct RunningCounters
+    {
+        uint64_t txPackets   = 0;
+        uint64_t rxPackets   = 0;
+        uint64_t rxBytes     = 0;
+        uint64_t lostPackets = 0;
+        int64_t  delaySum    = 0; // TimeStep
+    };
+
+    StreamingMetrics()
+        : m_delayHistogram(0.001, 1000),
+          m_jitterHistogram(0.0001, 1000),
+          m_cells(1),
+          m_warmup(0)
+    {
+    }
+
+    /// Ignorar os pacotes enviados antes de warmup. Deve ser chamado antes
+    /// do Simulator::Run().
+    void SetWarmup(Time warmup)
+    {
+        m_warmup = warmup;
+    }
+
+    Time GetWarmup() const { return m_warmup; }
+
+    /// Número de células dos contadores correntes (padrão: 1, todos os
+    /// fluxos na célula 0).
+    void SetNCells(uint32_t nCells)
+    {
+        m_cells.assign(std::max<uint32_t>(nCells, 1), RunningCounters());
+    }
+
+    void SetFlowCell(uint32_t flow, uint32_t cell)
+    {
+        NS_ASSERT(cell < m_cells.size());
+        m_flows[flow].cell = cell;
+    }
+
+    /// Porta UDP do UE no fluxo, para os fluxos cuja porta não é vista no
+    /// RxTrace (a de recepção, na descida).
+    void SetFlowPort(uint32_t flow, uint16_t port)
+    {
+        m_flows[flow].port = port;
+    }
+
+    void SetFlowWeight(uint32_t flow, uint32_t weight)
+    {
+        NS_ASSERT(weight > 0);
+        m_flows[flow].weight = weight;
+    }
+
+    /// Registra o fluxo do UE com endereço ueAddress e devolve o seu índice.
+    uint32_t AddFlow(Ipv4Address ueAddress)
+    {
+        uint32_t index = m_flows.size();
+        m_flows.emplace_back();
+        m_addresses.push_back(ueAddress);
+
+        // Endereços em sequência (caso normal do EPC): fluxo = endereço -
+        // base. Na primeira quebra da sequência passa a usar o mapa.
+        if (index == 0)
+        {
+            m_addressBase = ueAddress.Get();
+        }
+        if (m_denseAddresses && ueAddress.Get() != m_addressBase + index)
+        {
+            m_denseAddresses = false;
+            for (uint32_t i = 0; i < index; ++i)
+            {
+                m_flowByAddress[m_addresses[i].Get()] = i;
+            }
+        }
+        if (!m_denseAddresses)
+        {
+            m_flowByAddress[ueAddress.Get()] = index;
+        }
+        return index;
+    }
+
+    void ConnectClient(Ptr<Application> client, uint32_t flow)
+    {
+        client->TraceConnectWithoutContext("Tx", MakeBoundCallback(&StreamingMetrics::TxTrace,
+                                                                   this,
+                                                                   flow));
+    }
+
+    void ConnectServer(Ptr<Application> server)
+    {
+        server->TraceConnectWithoutContext("RxWithAddresses",
+                                           MakeCallback(&StreamingMetrics::RxTrace, this));
+    }
+
+    void NotifyTx(uint32_t flow)
+    {
+        // Os números de sequência começam em 0 em cada fonte, então o
+        // primeiro pacote medido tem sequência seqBase.
+        if (Simulator::Now() < m_warmup)
+        {
+            ++m_flows[flow].seqBase;
+            return;
+        }
+        FlowCounters& f = m_flows[flow];
+        ++f.txPackets;
+        m_cells[f.cell].txPackets += f.weight;
+    }
+
+    /// Chamado a cada pacote entregue ao servidor; o pacote ainda contém o
+    /// SeqTsHeader escrito pelo cliente no envio.
+    void NotifyRx(Ptr<const Packet> packet, uint32_t flow)
+    {
+        SeqTsHeader seqTs;
+        packet->PeekHeader(seqTs);
+        if (seqTs.GetTs() < m_warmup)
+        {
+            return;
+        }
+        Time delay = Simulator::Now() - seqTs.GetTs();
+
+        FlowCounters& f = m_flows[flow];
+        RunningCounters& c = m_cells[f.cell];
+        // Mesma conta de GetLostPackets(), feita de forma incremental: um
+        // salto na sequência soma o buraco, um pacote atrasado o desconta.
+        uint32_t w = f.weight;
+        uint32_t expected = f.rxPackets > 0 ? f.maxSeq + 1 : f.seqBase;
+        if (seqTs.GetSeq() >= expected)
+        {
+            c.lostPackets += static_cast<uint64_t>(seqTs.GetSeq() - expected) * w;
+        }
+        else if (c.lostPackets >= w)
+        {
+            c.lostPackets -= w;
+        }
+        c.rxPackets += w;
+        c.rxBytes += packet->GetSize() + static_cast<uint64_t>(w) * kIpUdpHeaderBytes;
+        c.delaySum += delay.GetTimeStep() * w;
+
+        if (f.rxPackets > 0)
+        {
+            int64_t jitter = std::abs(delay.GetTimeStep() - f.lastDelay);
+            f.jitterSum += jitter;
+            m_jitterHistogram.Add(TimeStep(jitter).GetSeconds(), w);
+        }
+        f.lastDelay = delay.GetTimeStep();
+        f.delaySum += delay.GetTimeStep();
+        f.maxSeq = std::max(f.maxSeq, seqTs.GetSeq());
+        ++f.rxPackets;
+        f.rxBytes += packet->GetSize() + kIpUdpHeaderBytes;
+
+        m_delayHistogram.Add(delay.GetSeconds(), w);
+    }
+
+    /**
+     * Pacotes perdidos do fluxo: buracos na sequência recebida. Pacotes
+     * enviados depois do último recebido ainda podem estar em trânsito no
+     * fim da simulação e não contam (como no FlowMonitor); um fluxo que nada
+     * recebeu perde tudo o que enviou.
+     */
+    static uint32_t GetLostPackets(const FlowCounters& f)
+    {
+        if (f.rxPackets == 0)
+        {
+            return f.txPackets;
+        }
+        uint32_t expected = f.maxSeq + 1 - f.seqBase;
+        return expected > f.rxPackets ? expected - f.rxPackets : 0;
+    }
+
+    /// Varredura linear da tabela, só com somas inteiras; as somas de
+    /// tempo são convertidas para segundos uma vez, no fim. Cada fluxo conta
+    /// weight vezes, e os bytes somam um cabeçalho IP/UDP por UE.
+    Totals GetTotals() const
+    {
+        Totals t;
+        int64_t delaySum = 0;
+        int64_t jitterSum = 0;
+        for (const FlowCounters& f : m_flows)
+        {
+            uint64_t w = f.weight;
+            delaySum += f.delaySum * static_cast<int64_t>(w);
+            jitterSum += f.jitterSum * static_cast<int64_t>(w);
+            t.txPackets += f.txPackets * w;
+            t.rxPackets += f.rxPackets * w;
+            t.rxBytes += f.rxBytes + (w - 1) * f.rxPackets * kIpUdpHeaderBytes;
+            t.lostPackets += GetLostPackets(f) * w;
+        }
+        t.delaySum = TimeStep(delaySum).GetSeconds();
+        t.jitterSum = TimeStep(jitterSum).GetSeconds();
+        return t;
+    }
+
+    uint32_t GetNCells() const { return m_cells.size(); }
+    const RunningCounters& GetCellCounters(uint32_t cell) const { return m_cells[cell]; }
+
+    /// Soma dos contadores correntes de todas as células.
+    RunningCounters GetRunningTotals() const
+    {
+        RunningCounters total;
+        for (const RunningCounters& c : m_cells)
+        {
+            total.txPackets += c.txPackets;
+            total.rxPackets += c.rxPackets;
+            total.rxBytes += c.rxBytes;
+            total.lostPackets += c.lostPackets;
+            total.delaySum += c.delaySum;
+        }
+        return total;
+    }
+
+    uint32_t GetNFlows() const { return m_flows.size(); }
+    const FlowCounters& GetFlow(uint32_t flow) const { return m_flows[flow]; }
+    Ipv4Address GetFlowAddress(uint32_t flow) const { return m_addresses[flow]; }
+    /// Porta UDP do UE: a de origem vista no primeiro pacote recebido na
+    /// subida (0 se nenhum), a dada por SetFlowPort() na descida.
+    uint16_t GetFlowPort(uint32_t flow) const { return m_flows[flow].port; }
+
+    FixedHistogram& GetDelayHistogram() { return m_delayHistogram; }
+    FixedHistogram& GetJitterHistogram() { return m_jitterHistogram; }
+
+  private:
+    static void TxTrace(StreamingMetrics* metrics, uint32_t flow, Ptr<const Packet> /* packet */)
+    {
+        metrics->NotifyTx(flow);
+    }
+
+    void RxTrace(Ptr<const Packet> packet, const Address& from, const Address& /* local */)
+    {
+        InetSocketAddress source = InetSocketAddress::ConvertFrom(from);
+        uint32_t flow;
+        if (m_denseAddresses)
+        {
+            // Sem sinal: endereços abaixo da base dão índices fora da tabela
+            flow = source.GetIpv4().Get() - m_addressBase;
+            if (flow >= m_flows.size())
+            {
+                return;
+            }
+        }
+        else
+        {
+            auto it = m_flowByAddress.find(source.GetIpv4().Get());
+            if (it == m_flowByAddress.end())
+            {
+                return;
+            }
+            flow = it->second;
+        }
+        if (m_flows[flow].port == 0)
+        {
+            m_flows[flow].port = source.GetPort();
+        }
+        NotifyRx(packet, flow);
+    }
+
+    std::vector<FlowCounters> m_flows;
+    std::vector<Ipv4Address> m_addresses;
+    bool m_denseAddresses = true;
+    uint32_t m_addressBase = 0;
+    std::unordered_map<uint32_t, uint32_t> m_flowByAddress; // só fora da sequência
+    FixedHistogram m_delayHistogram;
+    FixedHistogram m_jitterHistogram;
+    std::vector<RunningCounters> m_cells;
+    Time m_warmup;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_METRICS_H */
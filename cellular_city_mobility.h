@@ -0,0 +1,240 @@
+/*
+ * cellular_city_mobility.h
+ *
+ * Passeio aleatório avaliado sob demanda (--ueMobility=lazy). O
+ * RandomWalk2dMobilityModel agenda um evento a cada troca de trecho (a cada
+ * 1 m percorrido, com os atributos padrão), o que com 500k UEs dá centenas
+ * de milhares de eventos por segundo simulado só de mobilidade. Aqui o
+ * movimento é o mesmo (trechos de LegDistance metros em direção e
+ * velocidade sorteadas, com reflexão nas bordas de Bounds), mas calculado em
+ * forma fechada na consulta: nenhum evento é agendado, e os trechos vencidos
+ * desde a última consulta são percorridos de uma vez.
+ *
+ * A posição é guardada por CacheResolution (1 ms, um TTI): as várias
+ * consultas de um mesmo subquadro (uma por eNodeB no cálculo de perda)
+ * devolvem o valor guardado. Freeze() para o UE na posição atual.
+ */
+
+#ifndef CELLULAR_CITY_MOBILITY_H
+#define CELLULAR_CITY_MOBILITY_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace ns3
+{
+
+class LazyRandomWalkMobilityModel : public MobilityModel
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid =
+            TypeId("ns3::LazyRandomWalkMobilityModel")
+                .SetParent<MobilityModel>()
+                .SetGroupName("Mobility")
+                .AddConstructor<LazyRandomWalkMobilityModel>()
+                .AddAttribute("Bounds",
+                              "Área do passeio; o UE é refletido nas bordas.",
+                              RectangleValue(Rectangle(0.0, 100.0, 0.0, 100.0)),
+                              MakeRectangleAccessor(&LazyRandomWalkMobilityModel::m_bounds),
+                              MakeRectangleChecker())
+                .AddAttribute("Speed",
+                              "Velocidade (m/s) de cada trecho.",
+                              StringValue("ns3::UniformRandomVariable[Min=2.0|Max=4.0]"),
+                              MakePointerAccessor(&LazyRandomWalkMobilityModel::m_speed),
+                              MakePointerChecker<RandomVariableStream>())
+                .AddAttribute("Direction",
+                              "Direção (rad) de cada trecho.",
+                              StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.283184]"),
+                              MakePointerAccessor(&LazyRandomWalkMobilityModel::m_direction),
+                              MakePointerChecker<RandomVariableStream>())
+                .AddAttribute("LegDistance",
+                              "Distância (m) percorrida antes de sortear novo trecho.",
+                              DoubleValue(1.0),
+                              MakeDoubleAccessor(&LazyRandomWalkMobilityModel::m_legDistance),
+                              MakeDoubleChecker<double>(1e-3))
+                .AddAttribute("CacheResolution",
+                              "Intervalo em que a posição consultada é reaproveitada "
+                              "(0: sem cache).",
+                              TimeValue(MilliSeconds(1)),
+                              MakeTimeAccessor(&LazyRandomWalkMobilityModel::m_cacheResolution),
+                              MakeTimeChecker());
+        return tid;
+    }
+
+    LazyRandomWalkMobilityModel() = default;
+
+    /// Para o UE na posição atual até o fim da simulação.
+    void Freeze()
+    {
+        Time now = Simulator::Now();
+        m_position = PositionAt(now);
+        m_segmentStart = now;
+        m_frozen = true;
+        m_velocity = Vector(0.0, 0.0, 0.0);
+        m_segmentEnd = Time::Max();
+        m_cacheBucket = -1;
+        NotifyCourseChange();
+    }
+
+  private:
+    Vector DoGetPosition() const override
+    {
+        Time now = Simulator::Now();
+        if (m_cacheResolution.IsStrictlyPositive())
+        {
+            int64_t bucket = now.GetTimeStep() / m_cacheResolution.GetTimeStep();
+            if (bucket != m_cacheBucket)
+            {
+                m_cacheBucket = bucket;
+                m_cachedPosition = PositionAt(now);
+            }
+            return m_cachedPosition;
+        }
+        return PositionAt(now);
+    }
+
+    void DoSetPosition(const Vector& position) override
+    {
+        m_position = position;
+        m_segmentStart = Simulator::Now();
+        m_cacheBucket = -1;
+        if (m_frozen)
+        {
+            m_segmentEnd = Time::Max();
+        }
+        else
+        {
+            m_legLeft = 0.0;
+            StartSegment();
+        }
+        NotifyCourseChange();
+    }
+
+    Vector DoGetVelocity() const override
+    {
+        const_cast<LazyRandomWalkMobilityModel*>(this)->Advance(Simulator::Now());
+        return m_velocity;
+    }
+
+    int64_t DoAssignStreams(int64_t stream) override
+    {
+        m_speed->SetStream(stream);
+        m_direction->SetStream(stream + 1);
+        return 2;
+    }
+
+    Vector PositionAt(Time t) const
+    {
+        const_cast<LazyRandomWalkMobilityModel*>(this)->Advance(t);
+        double dt = (t - m_segmentStart).GetSeconds();
+        return Vector(m_position.x + m_velocity.x * dt,
+                      m_position.y + m_velocity.y * dt,
+                      m_position.z);
+    }
+
+    /// Percorre os segmentos que terminaram até t. Uma troca de trecho (ou
+    /// reflexão) conta como troca de curso para quem segue o trace.
+    void Advance(Time t)
+    {
+        bool changed = false;
+        while (t >= m_segmentEnd)
+        {
+            double dt = (m_segmentEnd - m_segmentStart).GetSeconds();
+            m_position.x = std::clamp(m_position.x + m_velocity.x * dt, m_bounds.xMin, m_bounds.xMax);
+            m_position.y = std::clamp(m_position.y + m_velocity.y * dt, m_bounds.yMin, m_bounds.yMax);
+            m_segmentStart = m_segmentEnd;
+            StartSegment();
+            changed = true;
+        }
+        if (changed)
+        {
+            NotifyCourseChange();
+        }
+    }
+
+    /// Próximo segmento a partir de m_position em m_segmentStart: o resto do
+    /// trecho atual (refletido se parou na borda) ou um trecho novo.
+    void StartSegment()
+    {
+        if (m_legLeft <= 0.0)
+        {
+            double speed = m_speed->GetValue();
+            double direction = m_direction->GetValue();
+            m_velocity = Vector(speed * std::cos(direction), speed * std::sin(direction), 0.0);
+            m_legLeft = m_legDistance;
+        }
+        else
+        {
+            // Reflexão: inverte as componentes que apontam para fora da área
+            if ((m_position.x <= m_bounds.xMin && m_velocity.x < 0) ||
+                (m_position.x >= m_bounds.xMax && m_velocity.x > 0))
+            {
+                m_velocity.x = -m_velocity.x;
+            }
+            if ((m_position.y <= m_bounds.yMin && m_velocity.y < 0) ||
+                (m_position.y >= m_bounds.yMax && m_velocity.y > 0))
+            {
+                m_velocity.y = -m_velocity.y;
+            }
+        }
+
+        double speed = std::hypot(m_velocity.x, m_velocity.y);
+        if (speed <= 0.0)
+        {
+            m_legLeft = 0.0;
+            m_segmentEnd = Time::Max();
+            return;
+        }
+        double duration = m_legLeft / speed;
+        duration = std::min(duration, TimeToBorder(m_position.x, m_velocity.x, m_bounds.xMin,
+                                                   m_bounds.xMax));
+        duration = std::min(duration, TimeToBorder(m_position.y, m_velocity.y, m_bounds.yMin,
+                                                   m_bounds.yMax));
+        // Pelo menos um passo de tempo, para que o laço de Advance() avance
+        Time step = std::max(Seconds(duration), TimeStep(1));
+        m_legLeft -= speed * step.GetSeconds();
+        m_segmentEnd = m_segmentStart + step;
+    }
+
+    static double TimeToBorder(double p, double v, double lo, double hi)
+    {
+        if (v > 0)
+        {
+            return (hi - p) / v;
+        }
+        if (v < 0)
+        {
+            return (lo - p) / v;
+        }
+        return std::numeric_limits<double>::max();
+    }
+
+    Rectangle m_bounds;
+    Ptr<RandomVariableStream> m_speed;
+    Ptr<RandomVariableStream> m_direction;
+    double m_legDistance = 1.0;
+    Time m_cacheResolution;
+
+    Vector m_position;    // posição em m_segmentStart
+    Vector m_velocity;
+    Time m_segmentStart;
+    Time m_segmentEnd = Time::Max();
+    double m_legLeft = 0.0; // metros que faltam do trecho atual
+    bool m_frozen = false;
+
+    mutable int64_t m_cacheBucket = -1;
+    mutable Vector m_cachedPosition;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(LazyRandomWalkMobilityModel);
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_MOBILITY_H */
@@ -11,10 +11,33 @@
  *
  *   ./ns3.cellular_city_multicell_sim --tech=4g --nUes=200 --nEnbs=7 --areaSize=2000 --simTime=60
  *   ./ns3.cellular_city_multicell_sim --tech=5g --nUes=500000 --nEnbs=120 --areaSize=20000 --simTime=60
+ *
+ * Modo distribuído (ns-3 configurado com --enable-mpi): cada processo MPI
+ * simula um bloco geográfico da grade de eNodeBs com os seus UEs.
+ *
+ *   mpirun -np 4 ./ns3.cellular_city_multicell_sim --distributed --nUes=500000 --nEnbs=120
+ *
+ * UEs em movimento trocando de célula (X2 entre sites vizinhos da grade):
+ *
+ *   ./ns3.cellular_city_multicell_sim --handover --ueMobility=lazy --nUes=10000 --nEnbs=36
+ *
+ * Sites e UEs de um cenário gravado (mesmo layout entre execuções):
+ *
+ *   ./ns3.cellular_city_multicell_sim --saveScenario=cidade.scn --nUes=500000 --nEnbs=120
+ *   ./ns3.cellular_city_multicell_sim --scenario=cidade.scn
+ *
+ * Memória por UE de cada componente e UEs com o perfil reduzido:
+ *
+ *   ./ns3.cellular_city_multicell_sim --memReport --memBudget=256 --leanUe --nUes=10000
  */
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -25,10 +48,36 @@
 #include "ns3/applications-module.h"
 #include "ns3/flow-monitor-module.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
+
+#include "cellular_city_arena.h"
+#include "cellular_city_attach.h"
+#include "cellular_city_grid.h"
+#include "cellular_city_handover.h"
+#include "cellular_city_memory.h"
+#include "cellular_city_metrics.h"
+#include "cellular_city_pathloss.h"
+#include "cellular_city_sampler.h"
+#include "cellular_city_scenario.h"
+#include "cellular_city_scenariofile.h"
+#include "cellular_city_scheduler.h"
+#include "cellular_city_statsout.h"
+#include "cellular_city_steadystate.h"
+#include "cellular_city_streams.h"
+#include "cellular_city_timing.h"
+#include "cellular_city_traffic.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("CellularCityMultiCellSim");
 
+// Substituição do operator new/delete (só com -DCELLULAR_CITY_PACKET_ARENA); a
+// arena só é ligada com --packetArena
+CELLULAR_CITY_ARENA_OPERATORS
+
 int
 main(int argc, char *argv[])
 {
@@ -39,6 +88,48 @@ main(int argc, char *argv[])
     std::string tech      = "4g";   // "4g" ou "5g"
     bool        verbose   = true;
     double      areaSize  = 2000.0; // lado do quadrado da cidade, em metros
+    bool        distributed = false; // um bloco da grade por processo MPI
+    bool        perFlowStats = false;  // FlowMonitor com histogramas por fluxo
+    double      monitorFraction = 1.0; // fração dos UEs com FlowMonitor
+    std::string perFlowStatsFile = "cellular_city_multicell_flows.xml";
+    std::string statsOut;               // arquivo binário com as métricas por fluxo
+    bool        flowLog       = false;  // uma linha de log por fluxo no fim
+    double      sampleInterval = 0.0;   // ms de tempo simulado; 0 sem série temporal
+    std::string sampleOut     = "cellular_city_multicell_kpis.csv";
+    uint32_t    sampleBuffer  = 1024;   // amostras no buffer circular
+    bool        pooledTraffic = true;  // um gerador CBR para todos os UEs
+    uint32_t    trafficSlots  = 1;     // posições da roda do gerador agrupado
+    std::string scheduler     = "map"; // escalonador de eventos do ns-3
+    bool        eventProfile  = false; // tempo dos eventos por tipo
+    uint32_t    profileTop    = 20;    // tipos na tabela do perfil
+    std::string profileOut;            // pilhas dobradas para flamegraph
+    std::string attach        = "auto"; // associação inicial: auto ou grid
+    double      pathlossCacheRes = 0.0; // m; 0 desliga o cache de perda
+    double      interferenceRadius = 0.0; // m; 0 entrega o sinal a todos os eNodeBs
+    double      maxLossDb     = 0.0;   // dB; 0 sem limiar de perda
+    std::string saveAttach;            // grava posições, células e IPs após a associação
+    std::string loadAttach;            // parte da associação gravada com --saveAttach
+    double      appStart      = 0.5;   // s; início do tráfego dos UEs
+    double      warmup        = 0.0;   // s; pacotes enviados antes ficam fora das métricas
+    double      steadyStateCi = 0.0;   // meia-largura relativa alvo; 0 sem parada antecipada
+    double      batchSize     = 1.0;   // s; duração de um lote das médias em lotes
+    uint32_t    minBatches    = 10;
+    uint32_t    clusterSize   = 1;     // UEs por nó LTE agregado; 1 sem agrupamento
+    std::string fullCells;             // células mantidas com um nó por UE
+    std::string cellShards;            // bloco (EPC) de cada célula
+    std::string scenario;              // sites e UEs lidos de arquivo
+    std::string saveScenario;          // grava os sites e UEs desta execução
+    std::string ueMobility    = "walk"; // walk ou lazy
+    bool        freezeStable  = false; // UEs que não saem da célula ficam parados
+    uint32_t    sectors       = 1;     // setores por site: 1 (omni) ou 3
+    uint32_t    carriers      = 1;     // portadoras por setor
+    bool        handover      = false; // X2 entre sites vizinhos e handover A3
+    bool        memReport     = false; // memória por componente no fim
+    double      memBudget     = 0.0;   // GB; estimativa de UEs que cabem
+    bool        leanUe        = false; // UEs só com o que o cenário usa
+    bool        packetArena   = false; // objetos pequenos em listas livres próprias
+    bool        fixedStreams  = false; // streams do RNG por subsistema e índice
+    std::string traffic       = "ul";  // perfil de tráfego: ul, dl, voip ou video
 
     CommandLine cmd;
     cmd.AddValue("nUes", "Número de UEs (usuários)", nUes);
@@ -47,275 +138,1087 @@ main(int argc, char *argv[])
     cmd.AddValue("tech", "Tecnologia: 4g ou 5g", tech);
     cmd.AddValue("verbose", "Imprimir logs INFO", verbose);
     cmd.AddValue("areaSize", "Tamanho do lado da área da cidade (m)", areaSize);
+    cmd.AddValue("distributed",
+                 "Dividir a grade de eNodeBs em blocos, um por processo MPI",
+                 distributed);
+    cmd.AddValue("cellShards",
+                 "Bloco de cada célula (índices separados por vírgula, um por célula) com "
+                 "--distributed; cada bloco tem seu EPC e host remoto "
+                 "(vazio: blocos retangulares). Só muda a divisão entre os processos: "
+                 "dentro de cada um, todo o tráfego continua passando por um único PGW",
+                 cellShards);
+    cmd.AddValue("perFlowStats",
+                 "Instalar o FlowMonitor e guardar histogramas por fluxo (mais memória)",
+                 perFlowStats);
+    cmd.AddValue("perFlowStatsFile", "Arquivo XML do FlowMonitor com --perFlowStats",
+                 perFlowStatsFile);
+    cmd.AddValue("monitorFraction",
+                 "Fração dos UEs com FlowMonitor (< 1: amostra reprodutível, KPIs estimados "
+                 "com IC; implica --perFlowStats)",
+                 monitorFraction);
+    cmd.AddValue("statsOut",
+                 "Arquivo binário colunar com as métricas por fluxo (formato em "
+                 "cellular_city_statsout.h)",
+                 statsOut);
+    cmd.AddValue("flowLog", "Imprimir uma linha de log por fluxo no fim (lento com muitos UEs)",
+                 flowLog);
+    cmd.AddValue("sampleInterval",
+                 "Intervalo (ms de tempo simulado) da série temporal de indicadores (0: desligada)",
+                 sampleInterval);
+    cmd.AddValue("sampleOut", "CSV da série temporal com --sampleInterval", sampleOut);
+    cmd.AddValue("sampleBuffer", "Amostras no buffer circular da série temporal", sampleBuffer);
+    cmd.AddValue("pooledTraffic",
+                 "Usar um único gerador CBR para todos os UEs (false: um UdpClient por UE)",
+                 pooledTraffic);
+    cmd.AddValue("trafficSlots",
+                 "Fases do gerador agrupado dentro do intervalo (1: todos os UEs juntos)",
+                 trafficSlots);
+    cmd.AddValue("scheduler",
+                 "Escalonador de eventos: map, heap, list, calendar, priority ou wheel",
+                 scheduler);
+    cmd.AddValue("profile",
+                 "Medir o tempo de cada evento do Simulator::Run() por tipo (contador de "
+                 "ciclos) e imprimir os tipos mais caros",
+                 eventProfile);
+    cmd.AddValue("profileTop", "Tipos de evento na tabela de --profile", profileTop);
+    cmd.AddValue("profileOut",
+                 "Com --profile, gravar as pilhas dobradas (flamegraph.pl) neste arquivo "
+                 "(um por processo no modo distribuído)",
+                 profileOut);
+    cmd.AddValue("attach",
+                 "Associação inicial: auto (melhor RSRP entre todos os eNodeBs) ou grid "
+                 "(eNodeB mais próximo pela grade)",
+                 attach);
+    cmd.AddValue("pathlossCacheRes",
+                 "Resolução (m) do cache de perda de percurso por par UE/eNodeB (0: desligado)",
+                 pathlossCacheRes);
+    cmd.AddValue("interferenceRadius",
+                 "Raio (m) além do qual o sinal não é entregue nem gera interferência "
+                 "(0: sem corte)",
+                 interferenceRadius);
+    cmd.AddValue("maxLossDb",
+                 "Perda (dB) acima da qual o canal espectral descarta o sinal (0: sem limiar)",
+                 maxLossDb);
+    cmd.AddValue("saveAttach",
+                 "Gravar em arquivo a posição, a célula servidora e o IP de cada UE em "
+                 "--appStart (formato em cellular_city_attach.h)",
+                 saveAttach);
+    cmd.AddValue("loadAttach",
+                 "Criar os UEs nas posições de um arquivo de --saveAttach e associá-los "
+                 "direto à célula gravada",
+                 loadAttach);
+    cmd.AddValue("appStart", "Início (s) do tráfego dos UEs", appStart);
+    cmd.AddValue("clusterSize",
+                 "Agrupar os UEs de cada célula em nós LTE que representam até N UEs e "
+                 "enviam o tráfego somado (1: um nó por UE)",
+                 clusterSize);
+    cmd.AddValue("scenario",
+                 "Arquivo de cenário (--saveScenario ou gerado à parte) com os sites, o "
+                 "azimute dos setores e, opcionalmente, as posições dos UEs; substitui "
+                 "--nEnbs, --areaSize e, com UEs, --nUes",
+                 scenario);
+    cmd.AddValue("saveScenario",
+                 "Gravar os sites e as posições iniciais dos UEs desta execução como cenário",
+                 saveScenario);
+    cmd.AddValue("fullCells",
+                 "Células (índices na grade, separados por vírgula) mantidas com um nó por "
+                 "UE com --clusterSize",
+                 fullCells);
+    cmd.AddValue("ueMobility",
+                 "Mobilidade dos UEs: walk (RandomWalk2d) ou lazy (mesmo passeio calculado "
+                 "na consulta, sem eventos)",
+                 ueMobility);
+    cmd.AddValue("freezeStable",
+                 "Com --ueMobility=lazy, parar os UEs que não alcançam a borda da célula "
+                 "até --simTime",
+                 freezeStable);
+    cmd.AddValue("traffic",
+                 "Perfil de tráfego: ul (CBR de subida), dl (CBR de descida), voip (voz nos "
+                 "dois sentidos, com talkspurts) ou video (quadros em rajada na descida)",
+                 traffic);
+    cmd.AddValue("sectors",
+                 "Setores por site da grade: 1 (antena omni) ou 3 (antenas parabólicas "
+                 "a 0, 120 e 240 graus)",
+                 sectors);
+    cmd.AddValue("carriers",
+                 "Portadoras por setor, em EARFCNs vizinhas (até 3; requer --attach=grid)",
+                 carriers);
+    cmd.AddValue("handover",
+                 "Handover por RSRP (evento A3) com X2 só entre sites vizinhos na grade",
+                 handover);
+    cmd.AddValue("memReport",
+                 "Imprimir a memória (heap) de cada componente da montagem, por UE",
+                 memReport);
+    cmd.AddValue("memBudget",
+                 "Com --memReport, estimar quantos UEs cabem neste orçamento (GB)",
+                 memBudget);
+    cmd.AddValue("leanUe",
+                 "UEs sem pilha IPv6 e só com roteamento estático (menos memória por UE)",
+                 leanUe);
+    cmd.AddValue("packetArena",
+                 "Servir os objetos pequenos (pacotes, buffers, eventos) de uma arena com "
+                 "listas livres por tamanho, com estatísticas no fim (requer compilar "
+                 "com -DCELLULAR_CITY_PACKET_ARENA)",
+                 packetArena);
+    cmd.AddValue("fixedStreams",
+                 "Streams do gerador aleatório fixos por subsistema e índice global do UE "
+                 "e do eNodeB, independentes da ordem de construção e do bloco",
+                 fixedStreams);
+    cmd.AddValue("warmup",
+                 "Aquecimento (s): pacotes enviados antes disso ficam fora das métricas",
+                 warmup);
+    cmd.AddValue("steadyStateCi",
+                 "Parar quando a meia-largura do IC de 95% do atraso e do throughput, por "
+                 "médias em lotes, ficar abaixo desta fração da média (0: desligado)",
+                 steadyStateCi);
+    cmd.AddValue("batchSize", "Duração (s) de cada lote com --steadyStateCi", batchSize);
+    cmd.AddValue("minBatches", "Lotes mínimos antes de parar com --steadyStateCi", minBatches);
     cmd.Parse(argc, argv);
 
-    if (verbose)
+    // Daqui em diante os new/delete de até 1 KB usam a arena
+    NS_ABORT_MSG_IF(packetArena && !SmallObjectArena::kCompiled,
+                    "--packetArena requer compilar com -DCELLULAR_CITY_PACKET_ARENA");
+    NS_ABORT_MSG_IF(packetArena && !SmallObjectArena::Get().Enable(),
+                    "Não foi possível reservar a região da --packetArena");
+
+    NS_ABORT_MSG_IF(attach != "auto" && attach != "grid",
+                    "Valor inválido para --attach (use auto ou grid)");
+    NS_ABORT_MSG_IF(appStart <= 0 || appStart >= simTime,
+                    "--appStart deve estar entre 0 e --simTime");
+    NS_ABORT_MSG_IF(warmup < 0 || warmup >= simTime, "--warmup deve estar entre 0 e --simTime");
+    NS_ABORT_MSG_IF(monitorFraction <= 0 || monitorFraction > 1,
+                    "--monitorFraction deve estar em (0, 1]");
+    if (monitorFraction < 1.0)
     {
-        LogComponentEnable("CellularCityMultiCellSim", LOG_LEVEL_INFO);
+        perFlowStats = true;
     }
-
-    NS_LOG_INFO("Iniciando simulação multi-célula com "
-                << nUes << " UEs, " << nEnbs << " eNodeBs, tech=" << tech
-                << ", area=" << areaSize << "m x " << areaSize << "m");
-
-    // -------------------------
-    // 1) Helpers LTE + EPC
-    // -------------------------
-    Ptr<LteHelper> lteHelper = CreateObject<LteHelper>();
-    Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper>();
-    lteHelper->SetEpcHelper(epcHelper);
-
-    if (tech == "4g")
+    // Cada bloco pararia em um instante diferente e os totais reduzidos
+    // misturariam janelas de medida distintas.
+    NS_ABORT_MSG_IF(distributed && steadyStateCi > 0,
+                    "--steadyStateCi não é suportado com --distributed");
+    NS_ABORT_MSG_IF(clusterSize == 0, "--clusterSize deve ser pelo menos 1");
+    NS_ABORT_MSG_IF(freezeStable && ueMobility != "lazy",
+                    "--freezeStable requer --ueMobility=lazy");
+    NS_ABORT_MSG_IF(sectors != 1 && sectors != 3, "--sectors deve ser 1 ou 3");
+    NS_ABORT_MSG_IF(carriers == 0 || carriers > 3, "--carriers deve estar entre 1 e 3");
+    // A busca de célula do UE só mede a EARFCN configurada nele (a da
+    // primeira portadora); a associação explícita escolhe a portadora.
+    NS_ABORT_MSG_IF(carriers > 1 && attach != "grid" && loadAttach.empty(),
+                    "--carriers > 1 requer --attach=grid ou --loadAttach");
+    // A amostra do FlowMonitor mede os fluxos que chegam ao host remoto
+    NS_ABORT_MSG_IF(monitorFraction < 1.0 && traffic != "ul",
+                    "--monitorFraction requer --traffic=ul");
+    if (clusterSize > 1)
     {
-        lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(50)); // RBs
-        lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(50));
+        NS_ABORT_MSG_IF(traffic == "video", "--clusterSize não é compatível com --traffic=video");
+        // Um nó agregado teria um só talkspurt para todos os membros
+        NS_ABORT_MSG_IF(traffic == "voip", "--clusterSize não é compatível com --traffic=voip");
+        NS_ABORT_MSG_IF(!saveAttach.empty() || !loadAttach.empty(),
+                        "--clusterSize não é compatível com --saveAttach/--loadAttach");
+        NS_ABORT_MSG_IF(monitorFraction < 1.0,
+                        "--clusterSize não é compatível com --monitorFraction");
     }
-    else if (tech == "5g")
+
+    // Cenário de arquivo (mapeado em memória): os sites substituem a grade
+    // regular e, se houver UEs, as posições deles substituem o sorteio.
+    std::unique_ptr<ScenarioFile> scenarioFile;
+    if (!scenario.empty())
     {
-        lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(100)); // RBs
-        lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(100));
+        NS_ABORT_MSG_IF(!loadAttach.empty(), "--scenario não é compatível com --loadAttach");
+        scenarioFile = std::make_unique<ScenarioFile>(scenario);
+        nEnbs = scenarioFile->GetNSites();
+        areaSize = scenarioFile->GetAreaSize();
+        if (scenarioFile->GetNUes() > 0)
+        {
+            nUes = scenarioFile->GetNUes();
+        }
     }
-    else
+    NS_ABORT_MSG_IF(!saveScenario.empty() && !loadAttach.empty(),
+                    "--saveScenario não é compatível com --loadAttach");
+
+    // Cada processo MPI simula um bloco da grade (eNodeBs + UEs mais próximos
+    // deles) com EPC e host remoto próprios. Os blocos não trocam eventos
+    // entre si; só os totais da seção 7 são reduzidos no processo 0.
+    uint32_t systemId    = 0;
+    uint32_t systemCount = 1;
+    if (distributed)
     {
-        NS_ABORT_MSG("Valor inválido para --tech (use 4g ou 5g)");
+#ifdef NS3_MPI
+        MpiInterface::Enable(&argc, &argv);
+        systemId    = MpiInterface::GetSystemId();
+        systemCount = MpiInterface::GetSize();
+#else
+        NS_ABORT_MSG("--distributed requer o ns-3 configurado com --enable-mpi");
+#endif
     }
 
-    Ptr<Node> pgw = epcHelper->GetPgwNode();
+    ConfigureScheduler(scheduler, eventProfile);
 
-    // -------------------------
-    // 2) Host remoto (Internet)
-    // -------------------------
-    NodeContainer remoteHostContainer;
-    remoteHostContainer.Create(1);
-    Ptr<Node> remoteHost = remoteHostContainer.Get(0);
+    // CBR padrão a 20 ms com 200 bytes; cuidado: 500k UEs com isso é INSANO
+    TrafficProfile profile = TrafficProfile::Parse(traffic, 0.02, 200);
+    double   packetInterval = profile.interval;
+    uint32_t packetSize     = profile.packetSize;
 
-    InternetStackHelper internet;
-    internet.Install(remoteHostContainer);
+    // Um pacote agregado (--clusterSize) sai do UE inteiro pelo dispositivo
+    // LTE (MTU 30000 bytes) e é fragmentado pelo IP no S1-U (MTU 2000) e no
+    // enlace PGW-host remoto (MTU 1500), com remontagem no host remoto. O
+    // limite que descarta pacotes é o buffer de transmissão do RLC UM
+    // (ns3::LteRlcUm::MaxTxBufferSize, 10240 bytes): um SDU que não cabe nele
+    // é perdido em silêncio. O buffer é aumentado antes de se criar o RLC
+    // para guardar dois pacotes agregados.
+    uint32_t aggregateBytes = clusterSize * packetSize + StreamingMetrics::kIpUdpHeaderBytes;
+    if (clusterSize > 1)
+    {
+        NS_ABORT_MSG_IF(aggregateBytes > 30000,
+                        "--clusterSize grande demais: o pacote agregado excede a MTU LTE");
+        if (aggregateBytes > 10240)
+        {
+            Config::SetDefault("ns3::LteRlcUm::MaxTxBufferSize",
+                               UintegerValue(2 * aggregateBytes));
+        }
+    }
 
-    PointToPointHelper p2ph;
-    if (tech == "4g")
+    if (verbose || flowLog)
     {
-        p2ph.SetDeviceAttribute("DataRate", StringValue("10Gbps"));
-        p2ph.SetChannelAttribute("Delay", StringValue("10ms"));
+        LogComponentEnable("CellularCityMultiCellSim", LOG_LEVEL_INFO);
     }
-    else // 5g
+
+    NS_LOG_INFO("Iniciando simulação multi-célula com "
+                << nUes << " UEs, " << nEnbs << " eNodeBs, tech=" << tech
+                << ", area=" << areaSize << "m x " << areaSize << "m");
+    if (distributed)
     {
-        p2ph.SetDeviceAttribute("DataRate", StringValue("10Gbps"));
-        p2ph.SetChannelAttribute("Delay", StringValue("2ms"));
+        NS_LOG_INFO("Processo MPI " << systemId << " de " << systemCount);
     }
 
-    NetDeviceContainer internetDevs = p2ph.Install(pgw, remoteHost);
-    Ipv4AddressHelper ipv4h;
-    ipv4h.SetBase("1.0.0.0", "255.0.0.0");
-    Ipv4InterfaceContainer internetIfaces = ipv4h.Assign(internetDevs);
+    // Tempo de relógio de cada seção da montagem, impresso antes do Run(),
+    // e memória de cada componente (--memReport), impressa no fim
+    PhaseTimer setupTimer;
+    MemoryFootprint footprint;
 
-    Ipv4StaticRoutingHelper ipv4RoutingHelper;
-    Ptr<Ipv4StaticRouting> remoteHostStaticRouting =
-        ipv4RoutingHelper.GetStaticRouting(remoteHost->GetObject<Ipv4>());
-    remoteHostStaticRouting->AddNetworkRouteTo(
-        Ipv4Address("7.0.0.0"), Ipv4Mask("255.0.0.0"), 1);
+    // -------------------------
+    // 1) Helpers LTE + EPC
+    // -------------------------
+    CityTopology topology(tech);
+    Ptr<LteHelper> lteHelper = topology.GetLteHelper();
+    ConfigurePathloss(lteHelper, pathlossCacheRes, interferenceRadius, maxLossDb);
+    if (leanUe)
+    {
+        topology.SetLeanUes();
+    }
+    setupTimer.Mark("1) Helpers LTE + EPC");
+
+    // -------------------------
+    // 2) Host remoto (Internet)
+    // -------------------------
+    topology.BuildRemoteHost();
+    setupTimer.Mark("2) Host remoto");
+    footprint.Mark("Helpers, EPC e host remoto", false);
 
     // -------------------------
     // 3) Nós: múltiplos eNodeBs + UEs
     // -------------------------
     NodeContainer enbNodes;
     NodeContainer ueNodes;
-    enbNodes.Create(nEnbs);
-    ueNodes.Create(nUes);   // aceita uint32_t
+
+    CellGrid grid(nEnbs, areaSize);
+    if (scenarioFile)
+    {
+        grid.SetSites(scenarioFile->GetSitePositions(), scenarioFile->GetSiteAzimuths());
+    }
+    std::vector<uint32_t> shardOf;
+    {
+        std::istringstream shardList(cellShards);
+        std::string item;
+        while (std::getline(shardList, item, ','))
+        {
+            shardOf.push_back(std::stoul(item));
+        }
+    }
+    NS_ABORT_MSG_IF(!shardOf.empty() && systemCount == 1,
+                    "--cellShards requer --distributed");
+    GridTiling tiling = shardOf.empty() ? GridTiling(grid, systemCount)
+                                        : GridTiling(grid, systemCount, shardOf);
+    double half = areaSize / 2.0;
+
+    // Células deste processo (todas, fora do modo distribuído)
+    std::vector<uint16_t> localCells;
+    for (uint16_t i = 0; i < nEnbs; ++i)
+    {
+        if (tiling.GetTile(i) == systemId)
+        {
+            localCells.push_back(i);
+        }
+    }
+    // Cada site da grade tem sectors x carriers eNodeBs no mesmo lugar, um
+    // por setor e portadora, em sequência: (setor 0, portadora 0), (setor 0,
+    // portadora 1), ...
+    uint32_t perSite = sectors * carriers;
+    enbNodes.Create(localCells.size() * perSite);
 
     // 3.1 Mobilidade dos eNodeBs: grade sobre a área
     MobilityHelper mobilityEnb;
     mobilityEnb.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     mobilityEnb.Install(enbNodes);
 
-    uint16_t nRows = std::floor(std::sqrt(nEnbs));
-    if (nRows == 0) nRows = 1;
-    uint16_t nCols = std::ceil(static_cast<double>(nEnbs) / nRows);
+    for (uint16_t k = 0; k < localCells.size(); ++k)
+    {
+        Vector pos = grid.GetPosition(localCells[k]);
 
-    double half = areaSize / 2.0;
-    double dx = areaSize / (nCols + 1);
-    double dy = areaSize / (nRows + 1);
+        Ptr<MobilityModel> site = enbNodes.Get(k * perSite)->GetObject<MobilityModel>();
+        for (uint32_t j = 0; j < perSite; ++j)
+        {
+            Ptr<MobilityModel> mm = enbNodes.Get(k * perSite + j)->GetObject<MobilityModel>();
+            mm->SetPosition(pos);
+            // Perda de percurso calculada uma vez por UE e site: os setores
+            // e portadoras compartilham a entrada do cache (--pathlossCacheRes)
+            CachedPathlossModel::RegisterSite(mm, site);
+        }
+        NS_LOG_INFO("eNodeB " << localCells[k] << " em (" << pos.x << ", " << pos.y << ", "
+                              << pos.z << ")");
+    }
 
-    for (uint16_t i = 0; i < nEnbs; ++i)
+    // Vizinhança de cada célula com --interferenceRadius: eNodeBs da grade a
+    // até interferenceRadius metros, os únicos que ainda trocam sinal com os
+    // UEs próximos dela.
+    double meanNeighbours = 0.0;
+    if (interferenceRadius > 0 && !localCells.empty())
+    {
+        uint64_t nNeighbours = 0;
+        for (uint16_t cell : localCells)
+        {
+            Vector pos = grid.GetPosition(cell);
+            for (uint16_t j = 0; j < nEnbs; ++j)
+            {
+                if (CalculateDistance(pos, grid.GetPosition(j)) <= interferenceRadius)
+                {
+                    ++nNeighbours;
+                }
+            }
+        }
+        meanNeighbours = (double)nNeighbours / localCells.size();
+        NS_LOG_INFO("eNodeBs no raio de interferência (média): " << meanNeighbours);
+    }
+
+    // 3.2 Mobilidade dos UEs (uint32_t loops)
+    // Todos os processos sorteiam as posições de todos os UEs, na mesma ordem,
+    // e ficam só com os UEs cuja célula mais próxima pertence ao seu bloco.
+    // Assim a distribuição global é a mesma da execução em um só processo.
+    // Com --loadAttach as posições (já só as do bloco) vêm do arquivo.
+    std::vector<Vector> uePositions;
+    std::vector<Vector> allUePositions; // de todos os blocos, para --saveScenario
+    std::vector<AttachRecord> savedAttach;
+    // Índice global de cada UE local (--fixedStreams, --saveAttach); com
+    // --loadAttach, o gravado no arquivo
+    std::vector<uint64_t> ueKeys;
+    if (!loadAttach.empty())
     {
-        uint16_t row = i / nCols;
-        uint16_t col = i % nCols;
+        std::string path =
+            systemCount > 1 ? loadAttach + "." + std::to_string(systemId) : loadAttach;
+        savedAttach = LoadAttachFile(path, nEnbs * perSite, nUes, areaSize);
+        uePositions.reserve(savedAttach.size());
+        for (const AttachRecord& r : savedAttach)
+        {
+            uePositions.push_back(r.position);
+            ueKeys.push_back(r.key);
+        }
+        NS_LOG_INFO("Associação de " << savedAttach.size() << " UEs lida de " << path);
+    }
+    else if (scenarioFile && scenarioFile->GetNUes() > 0)
+    {
+        // Direto das colunas mapeadas, em paralelo; ueKeys é o índice no
+        // arquivo
+        scenarioFile->ReadUes(
+            [&](double x, double y) {
+                return systemCount == 1 || tiling.GetTile(grid.FindNearest(x, y)) == systemId;
+            },
+            uePositions,
+            ueKeys);
+        NS_LOG_INFO(uePositions.size() << " UEs do cenário " << scenario);
+        if (!saveScenario.empty() && systemId == 0)
+        {
+            std::vector<uint64_t> allKeys;
+            scenarioFile->ReadUes([](double, double) { return true; }, allUePositions, allKeys);
+        }
+    }
+    else
+    {
+        Ptr<UniformRandomVariable> posX = CreateObject<UniformRandomVariable>();
+        posX->SetAttribute("Min", DoubleValue(-half));
+        posX->SetAttribute("Max", DoubleValue(half));
 
-        double x = -half + (col + 1) * dx;
-        double y = -half + (row + 1) * dy;
-        double z = 30.0;
+        Ptr<UniformRandomVariable> posY = CreateObject<UniformRandomVariable>();
+        posY->SetAttribute("Min", DoubleValue(-half));
+        posY->SetAttribute("Max", DoubleValue(half));
+        if (fixedStreams)
+        {
+            CityStreams::AssignPositions(posX, posY);
+        }
 
-        Ptr<MobilityModel> mm = enbNodes.Get(i)->GetObject<MobilityModel>();
-        mm->SetPosition(Vector(x, y, z));
-        NS_LOG_INFO("eNodeB " << i << " em (" << x << ", " << y << ", " << z << ")");
+        uePositions.reserve(systemCount > 1 ? nUes / systemCount : nUes);
+        for (uint32_t i = 0; i < nUes; ++i)
+        {
+            double x = posX->GetValue();
+            double y = posY->GetValue();
+            if (!saveScenario.empty() && systemId == 0)
+            {
+                allUePositions.push_back(Vector(x, y, 1.5));
+            }
+            if (systemCount > 1 && tiling.GetTile(grid.FindNearest(x, y)) != systemId)
+            {
+                continue;
+            }
+            uePositions.push_back(Vector(x, y, 1.5));
+            ueKeys.push_back(i);
+        }
     }
 
-    // 3.2 Mobilidade dos UEs (uint32_t loops)
-    Ptr<UniformRandomVariable> posX = CreateObject<UniformRandomVariable>();
-    posX->SetAttribute("Min", DoubleValue(-half));
-    posX->SetAttribute("Max", DoubleValue(half));
+    // --saveScenario: sites da grade (ou do cenário lido) e posições
+    // iniciais de todos os UEs, antes dos agrupamentos
+    if (!saveScenario.empty() && systemId == 0)
+    {
+        std::vector<Vector> sites;
+        std::vector<double> azimuths;
+        for (uint16_t cell = 0; cell < nEnbs; ++cell)
+        {
+            sites.push_back(grid.GetPosition(cell));
+            azimuths.push_back(grid.GetAzimuth(cell));
+        }
+        ScenarioFile::Save(saveScenario, areaSize, sites, azimuths, allUePositions);
+        NS_LOG_INFO("Cenário gravado em " << saveScenario);
+        std::vector<Vector>().swap(allUePositions);
+    }
 
-    Ptr<UniformRandomVariable> posY = CreateObject<UniformRandomVariable>();
-    posY->SetAttribute("Min", DoubleValue(-half));
-    posY->SetAttribute("Max", DoubleValue(half));
+    // Agrupamentos (--clusterSize): fora de --fullCells, os UEs de cada
+    // célula viram nós com até clusterSize membros, no centroide deles (a
+    // célula de Voronoi é convexa, então o centroide continua nela). Os
+    // membros de um nó são vizinhos: a célula é dividida em cerca de
+    // sqrt(nós) anéis pela distância ao site, cada um com um número inteiro
+    // de nós, e cada anel é percorrido pelo ângulo em torno do site. ueWeights
+    // guarda quantos UEs cada nó representa; a chave do nó é a do primeiro
+    // membro.
+    std::vector<uint32_t> ueWeights;
+    if (clusterSize > 1)
+    {
+        std::vector<bool> fullCell(nEnbs, false);
+        std::istringstream cellList(fullCells);
+        std::string item;
+        while (std::getline(cellList, item, ','))
+        {
+            uint32_t cell = std::stoul(item);
+            NS_ABORT_MSG_IF(cell >= nEnbs, "Célula " << cell << " fora da grade em --fullCells");
+            fullCell[cell] = true;
+        }
 
-    Ptr<ListPositionAllocator> uePositionAlloc = CreateObject<ListPositionAllocator>();
-    for (uint32_t i = 0; i < nUes; ++i)
+        std::vector<std::vector<uint32_t>> byCell(nEnbs);
+        for (uint32_t i = 0; i < uePositions.size(); ++i)
+        {
+            byCell[grid.FindNearest(uePositions[i].x, uePositions[i].y)].push_back(i);
+        }
+
+        std::vector<Vector> nodePositions;
+        std::vector<uint64_t> nodeKeys;
+        for (uint16_t cell = 0; cell < nEnbs; ++cell)
+        {
+            std::vector<uint32_t>& members = byCell[cell];
+            uint32_t step = fullCell[cell] ? 1 : clusterSize;
+            if (step > 1 && members.size() > step)
+            {
+                Vector site = grid.GetPosition(cell);
+                auto dist2 = [&](uint32_t i) {
+                    double dx = uePositions[i].x - site.x;
+                    double dy = uePositions[i].y - site.y;
+                    return dx * dx + dy * dy;
+                };
+                auto angle = [&](uint32_t i) {
+                    return std::atan2(uePositions[i].y - site.y, uePositions[i].x - site.x);
+                };
+                std::sort(members.begin(), members.end(),
+                          [&](uint32_t a, uint32_t b) { return dist2(a) < dist2(b); });
+                uint32_t nodes = (members.size() + step - 1) / step;
+                uint32_t rings = std::max<uint32_t>(1, std::lround(std::sqrt(double(nodes))));
+                uint32_t perRing = (nodes + rings - 1) / rings * step;
+                for (uint32_t begin = 0; begin < members.size(); begin += perRing)
+                {
+                    uint32_t end = std::min<uint32_t>(begin + perRing, members.size());
+                    std::sort(members.begin() + begin, members.begin() + end,
+                              [&](uint32_t a, uint32_t b) { return angle(a) < angle(b); });
+                }
+            }
+            for (uint32_t first = 0; first < members.size(); first += step)
+            {
+                uint32_t last = std::min<uint32_t>(first + step, members.size());
+                Vector centroid(0.0, 0.0, 1.5);
+                for (uint32_t m = first; m < last; ++m)
+                {
+                    centroid.x += uePositions[members[m]].x;
+                    centroid.y += uePositions[members[m]].y;
+                }
+                centroid.x /= (last - first);
+                centroid.y /= (last - first);
+                nodePositions.push_back(centroid);
+                nodeKeys.push_back(ueKeys[members[first]]);
+                ueWeights.push_back(last - first);
+            }
+        }
+        NS_LOG_INFO(uePositions.size() << " UEs em " << nodePositions.size() << " nós LTE");
+        uePositions.swap(nodePositions);
+        ueKeys.swap(nodeKeys);
+    }
+    uint32_t nLocalUes = uePositions.size();
+    ueNodes.Create(nLocalUes);   // aceita uint32_t
+
+    if (systemCount > 1)
     {
-        double x = posX->GetValue();
-        double y = posY->GetValue();
-        uePositionAlloc->Add(Vector(x, y, 1.5));
+        NS_LOG_INFO("Bloco " << systemId << ": " << localCells.size() << " eNodeBs, "
+                             << nLocalUes << " UEs");
     }
 
-    MobilityHelper mobilityUe;
-    mobilityUe.SetPositionAllocator(uePositionAlloc);
-    mobilityUe.SetMobilityModel(
-        "ns3::RandomWalk2dMobilityModel",
-        "Bounds", RectangleValue(Rectangle(-half, half, -half, half)),
-        "Speed", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=2.0]"));
-    mobilityUe.Install(ueNodes);
+    Ptr<ListPositionAllocator> uePositionAlloc = CreateObject<ListPositionAllocator>();
+    for (const Vector& pos : uePositions)
+    {
+        uePositionAlloc->Add(pos);
+    }
+    CityTopology::InstallUeMobility(ueNodes, uePositionAlloc, half, ueMobility);
+    setupTimer.Mark("3) Nos e mobilidade");
+    footprint.Mark("Nos e mobilidade");
 
     // -------------------------
     // 4) Dispositivos LTE
     // -------------------------
-    NetDeviceContainer enbDevs = lteHelper->InstallEnbDevice(enbNodes);
-    NetDeviceContainer ueDevs  = lteHelper->InstallUeDevice(ueNodes);
+    if (handover)
+    {
+        GridHandover::Configure(lteHelper);
+    }
+    NetDeviceContainer enbDevs;
+    if (perSite == 1)
+    {
+        enbDevs = topology.InstallEnbs(enbNodes);
+    }
+    else
+    {
+        // Setores: antena parabólica de 70 graus (3 dB) apontada para o
+        // centro do setor. Portadoras: EARFCNs separadas pela largura de
+        // banda do perfil (0,1 MHz por EARFCN).
+        uint32_t earfcnStep = tech == "5g" ? 200 : 100;
+        if (sectors > 1)
+        {
+            lteHelper->SetEnbAntennaModelType("ns3::ParabolicAntennaModel");
+            lteHelper->SetEnbAntennaModelAttribute("Beamwidth", DoubleValue(70.0));
+        }
+        for (uint32_t k = 0; k < enbNodes.GetN(); ++k)
+        {
+            uint32_t sector = (k % perSite) / carriers;
+            uint32_t carrier = k % carriers;
+            if (sectors > 1)
+            {
+                lteHelper->SetEnbAntennaModelAttribute(
+                    "Orientation",
+                    DoubleValue(grid.GetAzimuth(localCells[k / perSite]) +
+                                sector * 360.0 / sectors));
+            }
+            lteHelper->SetEnbDeviceAttribute("DlEarfcn",
+                                             UintegerValue(100 + carrier * earfcnStep));
+            lteHelper->SetEnbDeviceAttribute("UlEarfcn",
+                                             UintegerValue(18100 + carrier * earfcnStep));
+            enbDevs.Add(topology.InstallEnbs(NodeContainer(enbNodes.Get(k))));
+        }
+    }
+    footprint.Mark("eNodeBs: dispositivos", false);
+
+    topology.InstallUes(ueNodes, &footprint);
 
-    internet.Install(ueNodes);
-    Ipv4InterfaceContainer ueIfaces =
-        epcHelper->AssignUeIpv4Address(NetDeviceContainer(ueDevs));
+    if (fixedStreams)
+    {
+        std::vector<uint64_t> enbKeys;
+        for (uint16_t cell : localCells)
+        {
+            for (uint32_t j = 0; j < perSite; ++j)
+            {
+                enbKeys.push_back(cell * perSite + j);
+            }
+        }
+        CityStreams::Assign(lteHelper, enbDevs, enbKeys, ueNodes, topology.GetUeDevices(),
+                            ueKeys);
+    }
+
+    // Com --freezeStable, um UE a mais de kUeMaxSpeed * simTime metros da
+    // borda da sua célula não muda de célula mais próxima durante a
+    // simulação; ele fica parado e não gasta nada com mobilidade.
+    if (freezeStable)
+    {
+        double reach = CityTopology::kUeMaxSpeed * simTime;
+        uint32_t frozen = 0;
+        for (uint32_t i = 0; i < nLocalUes; ++i)
+        {
+            if (grid.DistanceToBorder(uePositions[i].x, uePositions[i].y) > reach)
+            {
+                ueNodes.Get(i)->GetObject<LazyRandomWalkMobilityModel>()->Freeze();
+                ++frozen;
+            }
+        }
+        NS_LOG_INFO(frozen << " de " << nLocalUes << " UEs parados (--freezeStable)");
+    }
+    uePositions.clear();
+    uePositions.shrink_to_fit();
+    const NetDeviceContainer& ueDevs = topology.GetUeDevices();
+
+    // Índice local (em enbDevs) do primeiro eNodeB de cada site da grade; -1
+    // fora do bloco
+    std::vector<int32_t> enbIndex(nEnbs, -1);
+    for (uint32_t k = 0; k < localCells.size(); ++k)
+    {
+        enbIndex[localCells[k]] = k * perSite;
+    }
+    // eNodeB do site para um UE em (x, y): setor voltado para ele e
+    // portadoras alternadas entre os UEs
+    auto siteEnb = [&](uint16_t cell, double x, double y, uint32_t ue) {
+        return enbIndex[cell] + grid.FindSector(cell, x, y, sectors) * carriers + ue % carriers;
+    };
+
+    if (!savedAttach.empty())
+    {
+        // Os endereços vêm do EPC na ordem dos UEs; com as mesmas posições e
+        // a mesma ordem eles têm de coincidir com os gravados.
+        const Ipv4InterfaceContainer& ueIfaces = topology.GetUeInterfaces();
+        uint32_t reattached = 0;
+        for (uint32_t i = 0; i < nLocalUes; ++i)
+        {
+            const AttachRecord& r = savedAttach[i];
+            NS_ABORT_MSG_IF(ueIfaces.GetAddress(i).Get() != r.address,
+                            "UE " << i << ": endereço " << ueIfaces.GetAddress(i)
+                                  << " difere do gravado em --loadAttach");
 
-    for (uint32_t i = 0; i < nUes; ++i)
+            // UE que não estava conectado na gravação: site mais próximo
+            if (r.cell == AttachRecord::kNoCell)
+            {
+                uint16_t cell = grid.FindNearest(r.position.x, r.position.y);
+                lteHelper->Attach(ueDevs.Get(i),
+                                  enbDevs.Get(siteEnb(cell, r.position.x, r.position.y, i)));
+                ++reattached;
+                continue;
+            }
+            uint32_t cell = r.cell / perSite;
+            NS_ABORT_MSG_IF(cell >= nEnbs || enbIndex[cell] < 0,
+                            "UE " << i << ": célula " << r.cell
+                                  << " fora do bloco deste processo");
+            lteHelper->Attach(ueDevs.Get(i), enbDevs.Get(enbIndex[cell] + r.cell % perSite));
+        }
+        if (reattached > 0)
+        {
+            NS_LOG_INFO(reattached << " UEs sem célula no arquivo associados ao eNodeB mais próximo");
+        }
+    }
+    else if (attach == "grid")
     {
-        Ptr<Node> ue = ueNodes.Get(i);
-        Ptr<Ipv4StaticRouting> ueStaticRouting =
-            ipv4RoutingHelper.GetStaticRouting(ue->GetObject<Ipv4>());
-        ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(), 1);
+        // Os eNodeBs formam uma grade regular com a mesma potência, então a
+        // célula de melhor RSRP inicial é a mais próxima: CellGrid::FindNearest()
+        // só examina as células vizinhas à posição do UE, no lugar de medir
+        // todos os pares UE x eNodeB. Com --sectors o setor é o voltado para
+        // o UE.
+        for (uint32_t i = 0; i < nLocalUes; ++i)
+        {
+            Vector pos = ueNodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+            uint16_t cell = grid.FindNearest(pos.x, pos.y);
+            NS_ASSERT_MSG(enbIndex[cell] >= 0, "UE fora do bloco deste processo");
+            lteHelper->Attach(ueDevs.Get(i), enbDevs.Get(siteEnb(cell, pos.x, pos.y, i)));
+        }
     }
+    else
+    {
+        // Associação automática: melhor eNodeB (RSRP)
+        lteHelper->Attach(ueDevs);
+    }
+    setupTimer.Mark("4) Dispositivos LTE e pilha IP");
+    footprint.Mark("Associacao");
 
-    // Associação automática: melhor eNodeB (RSRP)
-    lteHelper->Attach(ueDevs);
+    // X2 só entre sites vizinhos do bloco: os blocos têm EPCs separados
+    GridHandover gridHandover;
+    if (handover)
+    {
+        gridHandover.Connect(lteHelper, enbDevs, grid, enbIndex, perSite, carriers);
+        NS_LOG_INFO(gridHandover.GetX2Links() << " enlaces X2");
+        setupTimer.Mark("4.1) X2 e handover");
+        footprint.Mark("X2 e handover", false);
+    }
 
     // -------------------------
     // 5) Aplicações (tráfego UDP)
     // -------------------------
-    uint16_t dlPort = 1234;
+    uint16_t dlPort         = 1234;  // UdpServer do host remoto (subida)
+    uint16_t ueSinkPort     = 1235;  // sockets de recepção dos UEs (descida)
 
-    UdpServerHelper udpServer(dlPort);
-    ApplicationContainer serverApps = udpServer.Install(remoteHost);
-    serverApps.Start(Seconds(0.1));
-    serverApps.Stop(Seconds(simTime));
+    // Por padrão um único gerador envia os pacotes de todos os UEs (um evento
+    // por posição da roda a cada intervalo); com --pooledTraffic=false volta
+    // a instalar um UdpClient por UE.
+    UplinkCbrTraffic uplinkTraffic(topology.GetRemoteHost(), topology.GetRemoteAddress(), dlPort,
+                                   Seconds(packetInterval), packetSize, pooledTraffic,
+                                   trafficSlots);
+    if (!ueWeights.empty())
+    {
+        uplinkTraffic.SetWeights(ueWeights);
+    }
+    if (profile.voice)
+    {
+        uplinkTraffic.SetVoice(ueKeys);
+    }
+    if (profile.uplink)
+    {
+        uplinkTraffic.Install(ueNodes, Seconds(appStart), Seconds(simTime));
+    }
 
-    ApplicationContainer clientApps;
-    double   packetInterval = 0.02; // cuidado: 500k UEs com isso é INSANO
-    uint32_t packetSize     = 200;
+    // Descida: um único gerador no host remoto para todos os UEs
+    std::unique_ptr<DownlinkTraffic> downlinkTraffic;
+    if (profile.downlink)
+    {
+        downlinkTraffic = std::make_unique<DownlinkTraffic>(
+            topology, ueSinkPort, Seconds(packetInterval), packetSize, trafficSlots);
+        if (profile.video)
+        {
+            downlinkTraffic->SetVideo();
+        }
+        if (profile.voice)
+        {
+            downlinkTraffic->SetVoice(ueKeys);
+        }
+        if (!ueWeights.empty())
+        {
+            downlinkTraffic->SetWeights(ueWeights);
+        }
+        downlinkTraffic->Install(ueNodes, Seconds(appStart), Seconds(simTime));
+        if (fixedStreams)
+        {
+            downlinkTraffic->AssignStreams(CityStreams::Traffic(ueKeys));
+        }
+    }
 
-    for (uint32_t i = 0; i < nUes; ++i)
+    // Estado depois da associação, no início do tráfego: posição atual,
+    // célula servidora (índice na grade) e endereço de cada UE.
+    if (!saveAttach.empty())
     {
-        UdpClientHelper udpClient(internetIfaces.GetAddress(1), dlPort);
-        udpClient.SetAttribute("MaxPackets", UintegerValue(0xFFFFFFFF));
-        udpClient.SetAttribute("Interval", TimeValue(Seconds(packetInterval)));
-        udpClient.SetAttribute("PacketSize", UintegerValue(packetSize));
+        std::string path =
+            systemCount > 1 ? saveAttach + "." + std::to_string(systemId) : saveAttach;
+        Simulator::Schedule(Seconds(appStart), [&, path]() {
+            std::vector<uint32_t> cellOfId; // cellId do eNodeB -> célula do arquivo
+            for (uint32_t k = 0; k < enbDevs.GetN(); ++k)
+            {
+                uint16_t cellId = enbDevs.Get(k)->GetObject<LteEnbNetDevice>()->GetCellId();
+                if (cellId >= cellOfId.size())
+                {
+                    cellOfId.resize(cellId + 1, AttachRecord::kNoCell);
+                }
+                cellOfId[cellId] = localCells[k / perSite] * perSite + k % perSite;
+            }
 
-        clientApps.Add(udpClient.Install(ueNodes.Get(i)));
+            const Ipv4InterfaceContainer& ueIfaces = topology.GetUeInterfaces();
+            std::vector<AttachRecord> records(nLocalUes);
+            uint32_t connected = 0;
+            for (uint32_t i = 0; i < nLocalUes; ++i)
+            {
+                Ptr<LteUeRrc> rrc = ueDevs.Get(i)->GetObject<LteUeNetDevice>()->GetRrc();
+                AttachRecord& r = records[i];
+                r.position = ueNodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+                r.cell = AttachRecord::kNoCell;
+                if (rrc->GetState() == LteUeRrc::CONNECTED_NORMALLY &&
+                    rrc->GetCellId() < cellOfId.size())
+                {
+                    r.cell = cellOfId[rrc->GetCellId()];
+                    ++connected;
+                }
+                r.address = ueIfaces.GetAddress(i).Get();
+                r.key = ueKeys[i];
+            }
+            SaveAttachFile(path, nEnbs * perSite, nUes, areaSize, records);
+            NS_LOG_INFO("Associação gravada em " << path << " (" << connected << " de "
+                                                 << nLocalUes << " UEs conectados)");
+        });
     }
-
-    clientApps.Start(Seconds(0.5));
-    clientApps.Stop(Seconds(simTime));
+    // Depois daqui as chaves só servem ao --saveAttach
+    if (saveAttach.empty())
+    {
+        ueKeys.clear();
+        ueKeys.shrink_to_fit();
+    }
+    setupTimer.Mark("5) Aplicacoes");
+    footprint.Mark("Aplicacoes");
 
     // -------------------------
-    // 6) FlowMonitor (métricas)
+    // 6) Métricas
     // -------------------------
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    // Contadores globais e histogramas fixos atualizados durante a simulação
+    // pelo gerador (ou UdpClients) e pelo trace do UdpServer. O FlowMonitor,
+    // com histogramas por fluxo, só é instalado quando pedido com
+    // --perFlowStats. As métricas principais são as da subida; só da descida
+    // com --traffic=dl/video. Com --traffic=voip a descida tem as suas.
+    CityMetricsCollector collector;
+    StreamingMetrics& metrics = collector.GetMetrics();
+    metrics.SetNCells(nEnbs);
+    metrics.SetWarmup(Seconds(warmup));
+    std::unique_ptr<CityMetricsCollector> downlinkCollector;
+    if (profile.uplink)
+    {
+        uplinkTraffic.ConnectMetrics(metrics, topology.GetUeInterfaces());
+    }
+    if (profile.downlink)
+    {
+        StreamingMetrics* downlinkMetrics = &metrics;
+        if (profile.uplink)
+        {
+            downlinkCollector = std::make_unique<CityMetricsCollector>();
+            downlinkMetrics = &downlinkCollector->GetMetrics();
+            downlinkMetrics->SetWarmup(Seconds(warmup));
+        }
+        downlinkTraffic->ConnectMetrics(*downlinkMetrics, topology.GetUeInterfaces());
+    }
+    for (uint32_t i = 0; i < nLocalUes; ++i)
+    {
+        // Série temporal por célula (site da grade): a mais próxima da posição
+        // inicial
+        Vector pos = ueNodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+        metrics.SetFlowCell(i, grid.FindNearest(pos.x, pos.y));
+    }
+
+    std::unique_ptr<KpiSampler> sampler;
+    if (sampleInterval > 0)
+    {
+        std::string path =
+            systemCount > 1 ? sampleOut + "." + std::to_string(systemId) : sampleOut;
+        sampler = std::make_unique<KpiSampler>(metrics, Seconds(sampleInterval / 1000.0),
+                                               sampleBuffer, path);
+        sampler->Start(Seconds(appStart));
+    }
+    if (monitorFraction < 1.0)
+    {
+        // Só uma amostra dos UEs com sondas e classificador do FlowMonitor
+        uint32_t monitored = collector.EnableSampledFlowStats(
+            ueNodes, topology.GetRemoteHost(), monitorFraction, Seconds(warmup));
+        NS_LOG_INFO("FlowMonitor em " << monitored << " de " << nLocalUes << " UEs");
+    }
+    else if (perFlowStats)
+    {
+        collector.EnablePerFlowStats(Seconds(warmup));
+    }
+    std::unique_ptr<SteadyStateDetector> steadyState;
+    if (steadyStateCi > 0)
+    {
+        steadyState = std::make_unique<SteadyStateDetector>(metrics, Seconds(batchSize),
+                                                            steadyStateCi, minBatches);
+        steadyState->Start(Seconds(std::max(warmup, appStart)));
+    }
+    setupTimer.Mark("6) Metricas");
+    footprint.Mark("Metricas e FlowMonitor");
+
+    if (systemId == 0)
+    {
+        setupTimer.Print(std::cout);
+    }
 
     Simulator::Stop(Seconds(simTime));
+    auto runStart = std::chrono::steady_clock::now();
+    EventProfiler::Get().Start();
     Simulator::Run();
+    EventProfiler::Get().Finish();
+    double runWallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    if (eventProfile && !profileOut.empty())
+    {
+        std::string path =
+            systemCount > 1 ? profileOut + "." + std::to_string(systemId) : profileOut;
+        NS_ABORT_MSG_IF(!EventProfiler::Get().WriteFolded(path), "Não foi possível criar " << path);
+    }
+    if (sampler)
+    {
+        sampler->Finish();
+    }
+    // Contextos de UE, bearers e buffers criados pela conexão RRC
+    footprint.Mark("Durante a simulacao");
+    // Com --steadyStateCi a simulação pode parar antes de simTime; as taxas
+    // usam o tempo entre o fim do aquecimento e a parada.
+    double endTime = Simulator::Now().GetSeconds();
+    double window = endTime - warmup;
 
     // -------------------------
     // 7) Processar resultados
     // -------------------------
-    monitor->CheckForLostPackets();
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-    Ptr<Ipv4FlowClassifier> classifier =
-        DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-
-    double   totalDelay       = 0.0;
-    double   totalJitter      = 0.0;
-    uint64_t totalRxPackets   = 0;
-    uint64_t totalRxBytes     = 0;
-    uint64_t totalLostPackets = 0;
-
-    for (auto const &flow : stats)
+    if (flowLog)
     {
-        FlowId id = flow.first;
-        FlowMonitor::FlowStats fs = flow.second;
-        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(id);
-
-        double throughputMbps = (fs.rxBytes * 8.0) / (simTime * 1e6);
-        double meanDelayMs = 0.0;
-        if (fs.rxPackets > 0)
+        for (uint32_t i = 0; i < metrics.GetNFlows(); ++i)
         {
-            meanDelayMs = (fs.delaySum.GetSeconds() / fs.rxPackets) * 1000.0;
+            NS_LOG_INFO(collector.DescribeFlow(i, topology.GetRemoteAddress(), window));
         }
+    }
 
-        NS_LOG_INFO("Flow " << id
-                     << " (" << t.sourceAddress << " -> " << t.destinationAddress << "): "
-                     << "Throughput = " << throughputMbps << " Mbps, "
-                     << "Atraso médio = " << meanDelayMs << " ms, "
-                     << "RxPackets = " << fs.rxPackets << ", "
-                     << "LostPackets = " << fs.lostPackets);
-
-        totalDelay      += fs.delaySum.GetSeconds();
-        if (fs.rxPackets > 1)
-        {
-            totalJitter += fs.jitterSum.GetSeconds();
-        }
-        totalRxPackets   += fs.rxPackets;
-        totalRxBytes     += fs.rxBytes;
-        totalLostPackets += fs.lostPackets;
+    if (perFlowStats)
+    {
+        collector.WritePerFlowStats(perFlowStatsFile);
+        NS_LOG_INFO("Estatísticas por fluxo (FlowMonitor) em " << perFlowStatsFile);
     }
 
-    double meanDelayMs    = 0.0;
-    double jitterMs       = 0.0;
-    double throughputMbps = 0.0;
-    double lossRatePct    = 0.0;
+    if (!statsOut.empty())
+    {
+        // Um arquivo por processo no modo distribuído
+        std::string path = systemCount > 1 ? statsOut + "." + std::to_string(systemId) : statsOut;
+        // Com subida (ul, voip) o arquivo tem os fluxos de subida
+        FlowStatsWriter(metrics, topology.GetRemoteAddress(),
+                        profile.uplink ? dlPort : downlinkTraffic->GetSourcePort(), window,
+                        !profile.uplink)
+            .Write(path);
+        NS_LOG_INFO("Métricas por fluxo em " << path);
+    }
 
-    if (totalRxPackets > 0)
+    StreamingMetrics::Totals totals = metrics.GetTotals();
+    CityMetricsCollector::SampleSums sampleSums;
+    if (collector.IsSampled())
     {
-        double meanDelay  = totalDelay / (double)totalRxPackets;
-        double meanJitter = 0.0;
+        sampleSums = collector.GetSampleSums(topology.GetRemoteAddress(), window);
+    }
 
-        if (totalRxPackets > 1)
+    // Soma dos totais e do histograma de atraso de todos os blocos no
+    // processo 0, por MPI no modo distribuído.
+    auto reduceTotals = [&](StreamingMetrics::Totals& t, FixedHistogram& delayHistogram) {
+        double   sums[2]   = {t.delaySum, t.jitterSum};
+        uint64_t counts[3] = {t.rxPackets, t.rxBytes, t.lostPackets};
+        std::vector<uint64_t> delayBins = delayHistogram.GetCounts();
+#ifdef NS3_MPI
+        if (distributed)
         {
-            meanJitter = totalJitter / (double)(totalRxPackets - 1);
+            double   globalSums[2]   = {0.0, 0.0};
+            uint64_t globalCounts[3] = {0, 0, 0};
+            std::vector<uint64_t> globalBins(delayBins.size(), 0);
+            MPI_Reduce(sums, globalSums, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(counts, globalCounts, 3, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(delayBins.data(), globalBins.data(), delayBins.size(), MPI_UINT64_T,
+                       MPI_SUM, 0, MPI_COMM_WORLD);
+            std::copy(globalSums, globalSums + 2, sums);
+            std::copy(globalCounts, globalCounts + 3, counts);
+            delayBins.swap(globalBins);
         }
+#endif
+        t.delaySum    = sums[0];
+        t.jitterSum   = sums[1];
+        t.rxPackets   = counts[0];
+        t.rxBytes     = counts[1];
+        t.lostPackets = counts[2];
+        delayHistogram.SetCounts(delayBins);
+    };
+    reduceTotals(totals, metrics.GetDelayHistogram());
 
-        meanDelayMs    = meanDelay  * 1000.0;
-        jitterMs       = meanJitter * 1000.0;
-        throughputMbps = (totalRxBytes * 8.0) / (simTime * 1e6);
+    StreamingMetrics::Totals downlinkTotals;
+    if (downlinkCollector)
+    {
+        downlinkTotals = downlinkCollector->GetMetrics().GetTotals();
+        reduceTotals(downlinkTotals, downlinkCollector->GetMetrics().GetDelayHistogram());
     }
 
-    uint64_t totalOfferedPackets = totalRxPackets + totalLostPackets;
-    if (totalOfferedPackets > 0)
+#ifdef NS3_MPI
+    if (distributed)
     {
-        lossRatePct = (double)totalLostPackets * 100.0 / (double)totalOfferedPackets;
+        CityMetricsCollector::SampleSums globalSample;
+        MPI_Reduce(sampleSums.Data(), globalSample.Data(), CityMetricsCollector::SampleSums::kFields,
+                   MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        sampleSums = globalSample;
     }
+#endif
 
-    std::cout << "================ RESULTADOS MULTI-CELULA (" << tech << ") ================" << std::endl;
-    std::cout << "Usuarios (UEs):            " << nUes << std::endl;
-    std::cout << "eNodeBs (células):         " << nEnbs << std::endl;
-    std::cout << "Area da cidade (m):        " << areaSize << " x " << areaSize << std::endl;
-    std::cout << "Tempo de simulacao (s):    " << simTime << std::endl;
-    std::cout << "Atraso medio (ms):         " << meanDelayMs << std::endl;
-    std::cout << "Jitter medio (ms):         " << jitterMs << std::endl;
-    std::cout << "Throughput total (Mbps):   " << throughputMbps << std::endl;
-    std::cout << "Taxa de perda (%):         " << lossRatePct << std::endl;
-    std::cout << "Pacotes recebidos:         " << totalRxPackets << std::endl;
-    std::cout << "Pacotes perdidos:          " << totalLostPackets << std::endl;
-    std::cout << "================================================================" << std::endl;
+    uint64_t handovers[3] = {gridHandover.GetX2Links(), gridHandover.GetTriggeredHandovers(),
+                             gridHandover.GetCompletedHandovers()};
+#ifdef NS3_MPI
+    if (distributed && handover)
+    {
+        uint64_t globalHandovers[3] = {0, 0, 0};
+        MPI_Reduce(handovers, globalHandovers, 3, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        std::copy(globalHandovers, globalHandovers + 3, handovers);
+    }
+#endif
+
+    if (systemId == 0)
+    {
+        std::cout << "================ RESULTADOS MULTI-CELULA (" << tech << ") ================" << std::endl;
+        std::cout << "Usuarios (UEs):            " << nUes << std::endl;
+        std::cout << "eNodeBs (células):         " << nEnbs << std::endl;
+        if (perSite > 1)
+        {
+            std::cout << "Setores por site:          " << sectors << std::endl;
+            std::cout << "Portadoras por setor:      " << carriers << std::endl;
+        }
+        std::cout << "Area da cidade (m):        " << areaSize << " x " << areaSize << std::endl;
+        if (!scenario.empty())
+        {
+            std::cout << "Cenario:                   " << scenario << std::endl;
+        }
+        if (tiling.IsCustom())
+        {
+            std::cout << "Blocos (processos MPI):    " << tiling.GetNTiles() << " (--cellShards)" << std::endl;
+        }
+        else if (distributed)
+        {
+            std::cout << "Blocos (processos MPI):    " << tiling.GetTileRows() << " x "
+                      << tiling.GetTileCols() << std::endl;
+        }
+        if (interferenceRadius > 0)
+        {
+            std::cout << "Raio de interferencia (m): " << interferenceRadius << std::endl;
+            std::cout << "eNodeBs no raio (media):   " << meanNeighbours << std::endl;
+        }
+        if (clusterSize > 1)
+        {
+            std::cout << "UEs por agrupamento (max): " << clusterSize << std::endl;
+        }
+        if (handover)
+        {
+            std::cout << "Enlaces X2:                " << handovers[0] << std::endl;
+            std::cout << "Handovers iniciados:       " << handovers[1] << std::endl;
+            std::cout << "Handovers concluidos:      " << handovers[2] << std::endl;
+        }
+        std::cout << "Tempo de simulacao (s):    " << endTime << std::endl;
+        if (warmup > 0)
+        {
+            std::cout << "Aquecimento (s):           " << warmup << std::endl;
+            std::cout << "Janela de medida (s):      " << window << std::endl;
+        }
+        std::cout << "Perfil de trafego:         " << traffic << std::endl;
+        if (downlinkCollector)
+        {
+            std::cout << "---------------- subida ----------------" << std::endl;
+        }
+        collector.PrintKpis(std::cout, totals, window);
+        if (collector.IsSampled())
+        {
+            CityMetricsCollector::PrintSampleEstimate(std::cout, sampleSums, nUes);
+        }
+        if (downlinkCollector)
+        {
+            std::cout << "---------------- descida ----------------" << std::endl;
+            downlinkCollector->PrintKpis(std::cout, downlinkTotals, window, " descida");
+        }
+        std::cout << "================================================================" << std::endl;
+        if (steadyState)
+        {
+            steadyState->Print(std::cout);
+        }
+        PrintSchedulerReport(std::cout, scheduler, runWallSeconds);
+        if (eventProfile)
+        {
+            EventProfiler::Get().Print(std::cout, profileTop);
+        }
+        PrintPathlossReport(std::cout);
+        if (memReport)
+        {
+            footprint.Print(std::cout, nLocalUes, memBudget);
+        }
+        if (packetArena)
+        {
+            SmallObjectArena::Get().Print(std::cout);
+        }
+    }
 
     Simulator::Destroy();
+#ifdef NS3_MPI
+    if (distributed)
+    {
+        MpiInterface::Disable();
+    }
+#endif
     return 0;
 }
 
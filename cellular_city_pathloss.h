@@ -0,0 +1,346 @@
+/*
+ * cellular_city_pathloss.h
+ *
+ * Cache de perda de percurso para as simulações da cidade. O
+ * CachedPathlossModel envolve o modelo de propagação do LteHelper ("Inner")
+ * e guarda a perda (dB) de cada par transmissor/receptor junto com as
+ * posições quantizadas em "Resolution" metros. Enquanto os dois nós
+ * continuam na mesma célula da quantização e nenhum deles muda de curso
+ * (trace CourseChange da mobilidade), a perda guardada é reutilizada sem
+ * chamar o modelo interno.
+ *
+ * Os UEs andam a 0.5-2 m/s: com Resolution = 1 m o mesmo valor serve para
+ * centenas de subquadros de 1 ms.
+ *
+ * Com "CutoffDistance" > 0 o modelo também corta a interferência distante:
+ * pares além dessa distância recebem a perda fixa kCutoffLossDb, acima do
+ * MaxLossDb do canal espectral, que então nem entrega o sinal ao receptor.
+ */
+
+#ifndef CELLULAR_CITY_PATHLOSS_H
+#define CELLULAR_CITY_PATHLOSS_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace ns3
+{
+
+class CachedPathlossModel : public PropagationLossModel
+{
+  public:
+    /// Contadores somados sobre todas as instâncias (downlink e uplink).
+    struct Stats
+    {
+        uint64_t hits          = 0;
+        uint64_t misses        = 0;
+        uint64_t invalidations = 0; // trocas de curso observadas
+        uint64_t flushes       = 0; // cache esvaziado por atingir MaxEntries
+        uint64_t evaluated     = 0; // pares avaliados pelo canal
+        uint64_t culled        = 0; // pares além de CutoffDistance
+        uint64_t aboveMaxLoss  = 0; // pares com perda acima de MaxLossDb
+    };
+
+    /// Perda atribuída aos pares além de CutoffDistance.
+    static constexpr double kCutoffLossDb = 1000.0;
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid =
+            TypeId("ns3::CachedPathlossModel")
+                .SetParent<PropagationLossModel>()
+                .SetGroupName("Propagation")
+                .AddConstructor<CachedPathlossModel>()
+                .AddAttribute("Inner",
+                              "TypeId do modelo de propagação que calcula a perda.",
+                              StringValue("ns3::FriisPropagationLossModel"),
+                              MakeStringAccessor(&CachedPathlossModel::SetInner),
+                              MakeStringChecker())
+                .AddAttribute("Resolution",
+                              "Lado (m) da célula de quantização das posições (0: sem cache).",
+                              DoubleValue(1.0),
+                              MakeDoubleAccessor(&CachedPathlossModel::m_resolution),
+                              MakeDoubleChecker<double>(0.0))
+                .AddAttribute("MaxEntries",
+                              "Número máximo de pares guardados; ao atingir o limite o "
+                              "cache é esvaziado.",
+                              UintegerValue(4000000),
+                              MakeUintegerAccessor(&CachedPathlossModel::m_maxEntries),
+                              MakeUintegerChecker<uint32_t>(1))
+                .AddAttribute("CutoffDistance",
+                              "Distância (m) além da qual o sinal não é entregue (0: sem corte).",
+                              DoubleValue(0.0),
+                              MakeDoubleAccessor(&CachedPathlossModel::m_cutoffDistance),
+                              MakeDoubleChecker<double>(0.0))
+                .AddAttribute("MaxLossDb",
+                              "MaxLossDb do canal espectral, só para contar os pares "
+                              "descartados por ele.",
+                              DoubleValue(1e9),
+                              MakeDoubleAccessor(&CachedPathlossModel::m_maxLossDb),
+                              MakeDoubleChecker<double>());
+        return tid;
+    }
+
+    CachedPathlossModel() = default;
+
+    static const Stats& GetStats()
+    {
+        return s_stats;
+    }
+
+    /**
+     * Declara que sector está no mesmo lugar que site (setores e portadoras
+     * de um mesmo site): a perda de percurso de um UE até todos eles é a
+     * mesma, então os pares do cache usam o site como chave e a perda é
+     * calculada uma vez por UE e site.
+     */
+    static void RegisterSite(Ptr<MobilityModel> sector, Ptr<MobilityModel> site)
+    {
+        if (sector != site)
+        {
+            s_siteOf[PeekPointer(sector)] = PeekPointer(site);
+        }
+    }
+
+  private:
+    struct PairKey
+    {
+        const MobilityModel* a;
+        const MobilityModel* b;
+
+        bool operator==(const PairKey& o) const
+        {
+            return a == o.a && b == o.b;
+        }
+    };
+
+    struct PairKeyHash
+    {
+        size_t operator()(const PairKey& k) const
+        {
+            return std::hash<const void*>()(k.a) * 31 + std::hash<const void*>()(k.b);
+        }
+    };
+
+    struct Cell
+    {
+        int32_t x;
+        int32_t y;
+        int32_t z;
+
+        bool operator==(const Cell& o) const
+        {
+            return x == o.x && y == o.y && z == o.z;
+        }
+    };
+
+    struct Entry
+    {
+        Cell     cellA;
+        Cell     cellB;
+        uint32_t genA;
+        uint32_t genB;
+        double   lossDb;
+    };
+
+    void SetInner(std::string typeName)
+    {
+        ObjectFactory factory;
+        factory.SetTypeId(typeName);
+        m_inner = factory.Create<PropagationLossModel>();
+    }
+
+    Cell Quantize(const Vector& pos) const
+    {
+        return Cell{static_cast<int32_t>(std::floor(pos.x / m_resolution)),
+                    static_cast<int32_t>(std::floor(pos.y / m_resolution)),
+                    static_cast<int32_t>(std::floor(pos.z / m_resolution))};
+    }
+
+    /// Geração corrente do modelo de mobilidade; no primeiro uso liga o trace
+    /// CourseChange, que incrementa a geração e invalida os pares do nó.
+    uint32_t Generation(Ptr<MobilityModel> mm) const
+    {
+        auto it = m_generation.find(PeekPointer(mm));
+        if (it != m_generation.end())
+        {
+            return it->second;
+        }
+        mm->TraceConnectWithoutContext("CourseChange",
+                                       MakeCallback(&CachedPathlossModel::CourseChanged, this));
+        m_generation[PeekPointer(mm)] = 0;
+        return 0;
+    }
+
+    void CourseChanged(Ptr<const MobilityModel> mm) const
+    {
+        ++m_generation[PeekPointer(mm)];
+        ++s_stats.invalidations;
+    }
+
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override
+    {
+        ++s_stats.evaluated;
+        if (m_cutoffDistance > 0 && a->GetDistanceFrom(b) > m_cutoffDistance)
+        {
+            ++s_stats.culled;
+            return txPowerDbm - kCutoffLossDb;
+        }
+
+        double lossDb = m_resolution > 0 ? CachedLossDb(txPowerDbm, a, b)
+                                         : txPowerDbm - m_inner->CalcRxPower(txPowerDbm, a, b);
+        if (lossDb > m_maxLossDb)
+        {
+            ++s_stats.aboveMaxLoss;
+        }
+        return txPowerDbm - lossDb;
+    }
+
+    double CachedLossDb(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+    {
+        Cell cellA = Quantize(a->GetPosition());
+        Cell cellB = Quantize(b->GetPosition());
+        uint32_t genA = Generation(a);
+        uint32_t genB = Generation(b);
+
+        PairKey key{SiteOf(PeekPointer(a)), SiteOf(PeekPointer(b))};
+        auto it = m_cache.find(key);
+        if (it != m_cache.end())
+        {
+            const Entry& e = it->second;
+            if (e.genA == genA && e.genB == genB && e.cellA == cellA && e.cellB == cellB)
+            {
+                ++s_stats.hits;
+                return e.lossDb;
+            }
+        }
+
+        ++s_stats.misses;
+        // A perda não depende da potência transmitida nos modelos usados
+        // aqui (Friis, log-distance, ...): basta guardar a diferença.
+        double lossDb = txPowerDbm - m_inner->CalcRxPower(txPowerDbm, a, b);
+        if (it != m_cache.end())
+        {
+            it->second = Entry{cellA, cellB, genA, genB, lossDb};
+        }
+        else
+        {
+            if (m_cache.size() >= m_maxEntries)
+            {
+                m_cache.clear();
+                ++s_stats.flushes;
+            }
+            m_cache.emplace(key, Entry{cellA, cellB, genA, genB, lossDb});
+        }
+        return lossDb;
+    }
+
+    static const MobilityModel* SiteOf(const MobilityModel* mm)
+    {
+        if (s_siteOf.empty())
+        {
+            return mm;
+        }
+        auto it = s_siteOf.find(mm);
+        return it != s_siteOf.end() ? it->second : mm;
+    }
+
+    int64_t DoAssignStreams(int64_t stream) override
+    {
+        return m_inner->AssignStreams(stream);
+    }
+
+    Ptr<PropagationLossModel> m_inner;
+    double m_resolution;
+    uint32_t m_maxEntries;
+    double m_cutoffDistance;
+    double m_maxLossDb;
+
+    mutable std::unordered_map<PairKey, Entry, PairKeyHash> m_cache;
+    mutable std::unordered_map<const MobilityModel*, uint32_t> m_generation;
+    static inline Stats s_stats;
+    static inline std::unordered_map<const MobilityModel*, const MobilityModel*> s_siteOf;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachedPathlossModel);
+
+/**
+ * Liga o CachedPathlossModel no LteHelper (modelo interno padrão do
+ * LteHelper, Friis) quando há cache (resolution > 0), corte por distância
+ * (cutoffDistance > 0) ou limiar de perda (maxLossDb > 0). Deve ser chamado
+ * antes da instalação dos dispositivos.
+ */
+inline void
+ConfigurePathloss(Ptr<LteHelper> lteHelper,
+                  double resolution,
+                  double cutoffDistance = 0.0,
+                  double maxLossDb = 0.0)
+{
+    if (resolution <= 0 && cutoffDistance <= 0 && maxLossDb <= 0)
+    {
+        return;
+    }
+    lteHelper->SetPathlossModelType(CachedPathlossModel::GetTypeId());
+    lteHelper->SetPathlossModelAttribute("Resolution", DoubleValue(std::max(resolution, 0.0)));
+    lteHelper->SetPathlossModelAttribute("CutoffDistance",
+                                         DoubleValue(std::max(cutoffDistance, 0.0)));
+
+    // O canal espectral descarta o sinal com perda acima de MaxLossDb; o
+    // corte por distância usa kCutoffLossDb, sempre acima do limiar.
+    double channelMaxLossDb = maxLossDb > 0 ? maxLossDb : 1e9;
+    if (cutoffDistance > 0)
+    {
+        channelMaxLossDb = std::min(channelMaxLossDb, CachedPathlossModel::kCutoffLossDb - 1.0);
+    }
+    if (channelMaxLossDb < 1e9)
+    {
+        lteHelper->SetSpectrumChannelAttribute("MaxLossDb", DoubleValue(channelMaxLossDb));
+        lteHelper->SetPathlossModelAttribute("MaxLossDb", DoubleValue(channelMaxLossDb));
+    }
+}
+
+/// Blocos do corte de interferência e do cache, impressos depois do
+/// desempenho do simulador.
+inline void
+PrintPathlossReport(std::ostream& os)
+{
+    const CachedPathlossModel::Stats& st = CachedPathlossModel::GetStats();
+    if (st.culled + st.aboveMaxLoss > 0)
+    {
+        uint64_t skipped = st.culled + st.aboveMaxLoss;
+        os << "================ CORTE DE INTERFERENCIA ================" << std::endl;
+        os << "Pares avaliados:           " << st.evaluated << std::endl;
+        os << "Cortados por distancia:    " << st.culled << std::endl;
+        os << "Acima de MaxLossDb:        " << st.aboveMaxLoss << std::endl;
+        os << "Entregas evitadas (%):     " << skipped * 100.0 / st.evaluated << std::endl;
+        os << "========================================================" << std::endl;
+    }
+
+    uint64_t lookups = st.hits + st.misses;
+    if (lookups == 0)
+    {
+        return;
+    }
+    os << "================ CACHE DE PERDA DE PERCURSO ================" << std::endl;
+    os << "Consultas:                 " << lookups << std::endl;
+    os << "Acertos (%):               " << st.hits * 100.0 / lookups << std::endl;
+    os << "Trocas de curso:           " << st.invalidations << std::endl;
+    os << "Esvaziamentos:             " << st.flushes << std::endl;
+    os << "============================================================" << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_PATHLOSS_H */
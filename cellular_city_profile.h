@@ -0,0 +1,418 @@
+/*
+ * cellular_city_profile.h
+ *
+ * Perfil dos eventos do Simulator::Run() por tipo e local de agendamento
+ * (--profile). O CountingScheduler avisa o EventProfiler a cada evento
+ * inserido e a cada evento retirado da fila; o tempo até o próximo evento
+ * retirado (a execução do evento, incluindo os eventos que ele agenda) fica
+ * com o evento anterior. Os eventos não são envolvidos nem copiados.
+ *
+ * O tipo é a classe dinâmica do EventImpl. Para os eventos de
+ * Simulator::Schedule(&Classe::Metodo, obj, ...) ela traz a classe dona e a
+ * assinatura do método, mas não o método: StartFrame, StartSubFrame e
+ * EndSubFrame do LteEnbPhy têm o mesmo tipo. Por isso cada evento também
+ * guarda o local de onde foi agendado, a primeira função da pilha ao
+ * inserir o evento fora do simulador e do escalonador (LteEnbPhy::EndSubFrame
+ * para o StartSubFrame seguinte, por exemplo). O tempo gasto lendo a pilha
+ * é descontado do evento em execução.
+ *
+ * Os nomes vêm da tabela de símbolos dinâmicos (dladdr): as bibliotecas do
+ * ns-3 compiladas como compartilhadas (o padrão) dão o nome da função; as
+ * funções do próprio executável aparecem como <executável>+0x<deslocamento>
+ * (addr2line -Cfe <executável> <deslocamento>). Em builds estáticos não há
+ * símbolos e os eventos ficam só por tipo.
+ */
+
+#ifndef CELLULAR_CITY_PROFILE_H
+#define CELLULAR_CITY_PROFILE_H
+
+#include "ns3/event-impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ns3
+{
+
+class EventProfiler
+{
+  public:
+    static EventProfiler& Get()
+    {
+        static EventProfiler profiler;
+        return profiler;
+    }
+
+    /// Contador de ciclos (RDTSC) ou, fora do x86, nanossegundos.
+    static uint64_t ReadTicks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    /// Antes do Simulator::Run(): calibra os ciclos contra o relógio.
+    void Start()
+    {
+        // O primeiro backtrace() carrega o desenrolador (libgcc_s)
+        void* frames[kFrames];
+        backtrace(frames, kFrames);
+        m_startTicks = ReadTicks();
+        m_startTime = std::chrono::steady_clock::now();
+    }
+
+    /// Depois do Simulator::Run(): fecha o último evento.
+    void Finish()
+    {
+        uint64_t now = ReadTicks();
+        double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+        m_ticksPerSecond = seconds > 0 ? (now - m_startTicks) / seconds : 1e9;
+        Close(now);
+    }
+
+    /// Evento inserido na fila (chamado pelo escalonador): guarda o local
+    /// de agendamento.
+    void OnSchedule(const EventImpl* impl)
+    {
+        uint64_t start = ReadTicks();
+        void* frames[kFrames];
+        int n = backtrace(frames, kFrames);
+        // Pula os quadros até o simulador (o escalonador e este perfil) e
+        // depois o próprio simulador; o primeiro quadro seguinte é o local
+        const void* site = nullptr;
+        bool inSimulator = false;
+        for (int i = 0; i < n; ++i)
+        {
+            bool infrastructure = IsInfrastructure(frames[i]);
+            if (inSimulator && !infrastructure)
+            {
+                site = frames[i];
+                break;
+            }
+            inSimulator = inSimulator || infrastructure;
+        }
+        if (site)
+        {
+            m_sites[impl] = site;
+        }
+        if (m_current >= 0)
+        {
+            m_since += ReadTicks() - start;
+        }
+    }
+
+    /// Evento retirado sem executar (cancelado ou removido).
+    void OnDiscard(const EventImpl* impl)
+    {
+        m_sites.erase(impl);
+    }
+
+    /// Evento prestes a executar (chamado pelo escalonador).
+    void OnEvent(const EventImpl* impl)
+    {
+        uint64_t now = ReadTicks();
+        Close(now);
+        Key key{&typeid(*impl), nullptr};
+        auto site = m_sites.find(impl);
+        if (site != m_sites.end())
+        {
+            key.site = site->second;
+            m_sites.erase(site);
+        }
+        if (key != m_lastKey || m_entries.empty())
+        {
+            auto it = m_index.find(key);
+            if (it == m_index.end())
+            {
+                it = m_index.emplace(key, m_entries.size()).first;
+                m_entries.push_back({key, 0, 0});
+            }
+            m_lastKey = key;
+            m_lastEntry = it->second;
+        }
+        ++m_entries[m_lastEntry].count;
+        m_current = m_lastEntry;
+        m_since = now;
+    }
+
+    /**
+     * Bloco PERFIL DE EVENTOS e, depois do fechamento do bloco, a tabela com
+     * os top tipos por tempo: os nomes dos tipos têm "::" e ficam fora do
+     * que o parser dos blocos (cellular_city_runner.h) lê como resultados.
+     */
+    void Print(std::ostream& os, uint32_t top) const
+    {
+        std::vector<Row> rows = Merge();
+        uint64_t events = 0;
+        double seconds = 0.0;
+        for (const Row& r : rows)
+        {
+            events += r.count;
+            seconds += r.seconds;
+        }
+        os << "================ PERFIL DE EVENTOS ================" << std::endl;
+        os << "Eventos perfilados:        " << events << std::endl;
+        os << "Tempo nos eventos (s):     " << seconds << std::endl;
+        os << "Tipos de evento:           " << rows.size() << std::endl;
+        os << "===================================================" << std::endl;
+        os << "   tempo %     eventos   ns/evento  tipo <- agendado em" << std::endl;
+        char line[64];
+        for (uint32_t i = 0; i < std::min<size_t>(top, rows.size()); ++i)
+        {
+            const Row& r = rows[i];
+            std::snprintf(line, sizeof(line), "%9.2f %11llu %11.1f  ",
+                          seconds > 0 ? 100.0 * r.seconds / seconds : 0.0,
+                          static_cast<unsigned long long>(r.count),
+                          r.count > 0 ? 1e9 * r.seconds / r.count : 0.0);
+            os << line << r.label;
+            if (!r.site.empty())
+            {
+                os << " <- " << r.site;
+            }
+            os << std::endl;
+        }
+    }
+
+    /**
+     * Pilhas "dobradas" do flamegraph.pl / speedscope, uma linha por tipo e
+     * local: Simulator::Run;<classe dona>;<local>;<tipo> <microssegundos>.
+     */
+    bool WriteFolded(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+        for (const Row& r : Merge())
+        {
+            uint64_t us = static_cast<uint64_t>(r.seconds * 1e6);
+            if (us > 0)
+            {
+                out << "Simulator::Run;" << r.owner << ";"
+                    << (r.site.empty() ? "?" : r.site) << ";" << r.label << " " << us << "\n";
+            }
+        }
+        return static_cast<bool>(out);
+    }
+
+  private:
+    static constexpr int kFrames = 12;
+
+    struct Key
+    {
+        const std::type_info* type;
+        const void* site; // nullptr: local desconhecido
+
+        bool operator!=(const Key& o) const
+        {
+            return type != o.type || site != o.site;
+        }
+
+        bool operator==(const Key& o) const
+        {
+            return !(*this != o);
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const
+        {
+            return std::hash<const void*>()(k.type) * 31 + std::hash<const void*>()(k.site);
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        uint64_t count;
+        uint64_t ticks;
+    };
+
+    struct Row
+    {
+        std::string label;
+        std::string site;
+        std::string owner;
+        uint64_t count;
+        double seconds;
+    };
+
+    EventProfiler() = default;
+
+    void Close(uint64_t now)
+    {
+        if (m_current >= 0)
+        {
+            m_entries[m_current].ticks += now - m_since;
+            m_current = -1;
+        }
+    }
+
+    /// Quadro do simulador, do escalonador ou deste perfil; a resposta de
+    /// cada endereço de retorno fica guardada.
+    bool IsInfrastructure(const void* frame)
+    {
+        auto it = m_infrastructure.find(frame);
+        if (it != m_infrastructure.end())
+        {
+            return it->second;
+        }
+        static const char* const kClasses[] = {
+            "ns3::Simulator::",
+            "ns3::SimulatorImpl::",
+            "ns3::DefaultSimulatorImpl::",
+            "ns3::RealtimeSimulatorImpl::",
+            "ns3::DistributedSimulatorImpl::",
+            "ns3::NullMessageSimulatorImpl::",
+            "ns3::CountingScheduler::",
+            "ns3::EventProfiler::",
+        };
+        std::string name = Symbolize(frame);
+        name = name.substr(0, name.find('('));
+        bool infrastructure = false;
+        for (const char* c : kClasses)
+        {
+            infrastructure = infrastructure || name.find(c) != std::string::npos;
+        }
+        m_infrastructure.emplace(frame, infrastructure);
+        return infrastructure;
+    }
+
+    /// Nome da função que contém o endereço ou <objeto>+0x<deslocamento>.
+    static std::string Symbolize(const void* address)
+    {
+        Dl_info info;
+        if (dladdr(address, &info) == 0)
+        {
+            return "";
+        }
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+            std::free(demangled);
+            return name;
+        }
+        const char* file = info.dli_fname ? std::strrchr(info.dli_fname, '/') : nullptr;
+        char offset[32];
+        std::snprintf(offset, sizeof(offset), "+0x%llx",
+                      static_cast<unsigned long long>(static_cast<const char*>(address) -
+                                                      static_cast<const char*>(info.dli_fbase)));
+        return std::string(file ? file + 1 : info.dli_fname ? info.dli_fname : "?") + offset;
+    }
+
+    /// Entradas somadas pelo nome do tipo e do local, da mais cara à mais
+    /// barata.
+    std::vector<Row> Merge() const
+    {
+        std::map<std::pair<std::string, std::string>, Row> byLabel;
+        for (const Entry& e : m_entries)
+        {
+            std::string owner;
+            std::string label = Describe(*e.key.type, owner);
+            std::string site = e.key.site ? Symbolize(e.key.site) : "";
+            Row& r = byLabel.emplace(std::make_pair(label, site), Row{label, site, owner, 0, 0.0})
+                         .first->second;
+            r.count += e.count;
+            r.seconds += e.ticks / m_ticksPerSecond;
+        }
+        std::vector<Row> rows;
+        for (auto& [label, r] : byLabel)
+        {
+            rows.push_back(r);
+        }
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+            return a.seconds > b.seconds;
+        });
+        return rows;
+    }
+
+    /**
+     * Nome legível do tipo do evento. De
+     * ns3::MakeEvent<void (ns3::LteEnbPhy::*)(), ns3::LteEnbPhy*>(...)::EventMemberImpl
+     * fica "ns3::LteEnbPhy::*()", com owner "ns3::LteEnbPhy"; de funções,
+     * o primeiro argumento do MakeEvent.
+     */
+    static std::string Describe(const std::type_info& type, std::string& owner)
+    {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled ? demangled : type.name();
+        std::free(demangled);
+
+        const std::string prefix = "ns3::MakeEvent<";
+        if (name.compare(0, prefix.size(), prefix) == 0)
+        {
+            // Primeiro argumento do template, até a vírgula de nível zero
+            int depth = 0;
+            size_t end = prefix.size();
+            for (; end < name.size(); ++end)
+            {
+                char c = name[end];
+                depth += (c == '<' || c == '(') - (c == '>' || c == ')');
+                if (depth < 0 || (depth == 0 && c == ','))
+                {
+                    break;
+                }
+            }
+            name = name.substr(prefix.size(), end - prefix.size());
+        }
+
+        // Ponteiro para método: "R (Classe::*)(Args)"
+        size_t member = name.find("::*)");
+        size_t open = name.rfind('(', member);
+        if (member != std::string::npos && open != std::string::npos)
+        {
+            owner = name.substr(open + 1, member - open - 1);
+            return owner + "::*" + name.substr(member + 4);
+        }
+        owner = "funcoes";
+        return name;
+    }
+
+    uint64_t m_startTicks = 0;
+    std::chrono::steady_clock::time_point m_startTime;
+    double m_ticksPerSecond = 1e9;
+
+    std::unordered_map<Key, uint32_t, KeyHash> m_index;
+    std::vector<Entry> m_entries;
+    Key m_lastKey{nullptr, nullptr};
+    uint32_t m_lastEntry = 0;
+    int64_t m_current = -1; // entrada do evento em execução
+    uint64_t m_since = 0;
+
+    std::unordered_map<const EventImpl*, const void*> m_sites; // eventos na fila
+    std::unordered_map<const void*, bool> m_infrastructure;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_PROFILE_H */
@@ -0,0 +1,160 @@
+/*
+ * cellular_city_runner.h
+ *
+ * Execução das simulações da cidade como processos filhos, usada pela
+ * varredura de parâmetros e pelo benchmark: dispara o binário com a saída
+ * em um arquivo, espera o término (com o pico de memória residente do filho)
+ * e lê os blocos de resumo impressos pela simulação.
+ */
+
+#ifndef CELLULAR_CITY_RUNNER_H
+#define CELLULAR_CITY_RUNNER_H
+
+#include "ns3/core-module.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/// Linha "Rótulo:   valor" de um bloco de resumo.
+struct SummaryLine
+{
+    std::string block; // título do bloco, sem os '='
+    std::string label;
+    std::string value;
+};
+
+/// Processo filho terminado.
+struct ChildExit
+{
+    pid_t pid;
+    int status;
+    long maxRssKb; // pico de memória residente (ru_maxrss)
+};
+
+inline std::string
+Trim(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos)
+    {
+        return "";
+    }
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+/// Dispara args[0] com os argumentos args[1..] em um processo filho, com
+/// stdout/stderr em outPath.
+inline pid_t
+LaunchProcess(const std::vector<std::string>& args, const std::string& outPath)
+{
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "fork() falhou");
+    if (pid == 0)
+    {
+        int fd = open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            _exit(126);
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+
+        std::vector<char*> argv;
+        for (const auto& a : args)
+        {
+            argv.push_back(const_cast<char*>(a.c_str()));
+        }
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+/// Espera o término de qualquer filho (repete se interrompido por sinal).
+inline ChildExit
+WaitAnyProcess()
+{
+    ChildExit child{-1, 0, 0};
+    struct rusage usage = {};
+    do
+    {
+        child.pid = wait4(-1, &child.status, 0, &usage);
+    } while (child.pid < 0 && errno == EINTR);
+    NS_ABORT_MSG_IF(child.pid < 0, "wait4() falhou: " << std::strerror(errno));
+    child.maxRssKb = usage.ru_maxrss;
+    return child;
+}
+
+/// "ok", "falhou(<código>)" ou "sinal(<número>)".
+inline std::string
+DescribeExit(int status)
+{
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        return "ok";
+    }
+    if (WIFEXITED(status))
+    {
+        return "falhou(" + std::to_string(WEXITSTATUS(status)) + ")";
+    }
+    return "sinal(" + std::to_string(WTERMSIG(status)) + ")";
+}
+
+/**
+ * Lê as linhas "Rótulo:   valor" dos blocos de resumo da saída de uma
+ * execução (RESULTADOS, DESEMPENHO DO SIMULADOR, TEMPO DE INICIALIZACAO,
+ * ...). Um bloco abre com uma linha "==== TÍTULO ====" e fecha com uma linha
+ * só de '='.
+ */
+inline std::vector<SummaryLine>
+ReadSummaryBlocks(const std::string& outPath)
+{
+    std::vector<SummaryLine> lines;
+    std::ifstream in(outPath);
+    std::string line;
+    std::string block;
+    while (std::getline(in, line))
+    {
+        if (line.rfind("=====", 0) == 0)
+        {
+            size_t b = line.find_first_not_of('=');
+            block = "";
+            if (b != std::string::npos)
+            {
+                block = Trim(line.substr(b, line.find_last_not_of('=') - b + 1));
+            }
+            continue;
+        }
+        if (block.empty())
+        {
+            continue;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+        lines.push_back(
+            SummaryLine{block, Trim(line.substr(0, colon)), Trim(line.substr(colon + 1))});
+    }
+    return lines;
+}
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_RUNNER_H */
@@ -0,0 +1,212 @@
+/*
+ * cellular_city_sampler.h
+ *
+ * Série temporal dos indicadores durante a simulação (--sampleInterval). A
+ * cada intervalo de tempo simulado o KpiSampler copia os contadores
+ * correntes de cada célula e os globais (StreamingMetrics::RunningCounters)
+ * e a profundidade da fila de eventos para um buffer circular
+ * pré-alocado. Uma thread de escrita esvazia o buffer em segundo plano e
+ * grava o CSV com os valores de cada intervalo.
+ *
+ * O custo de uma amostra é proporcional ao número de células, nunca ao de
+ * fluxos. Se a escrita ficar para trás e o buffer encher, a simulação espera
+ * a thread liberar espaço; nenhuma amostra é descartada.
+ */
+
+#ifndef CELLULAR_CITY_SAMPLER_H
+#define CELLULAR_CITY_SAMPLER_H
+
+#include "ns3/core-module.h"
+
+#include "cellular_city_metrics.h"
+#include "cellular_city_scheduler.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+class KpiSampler
+{
+  public:
+    /// capacity: número de amostras (de todas as células) no buffer.
+    KpiSampler(const StreamingMetrics& metrics,
+               Time interval,
+               uint32_t capacity,
+               const std::string& path)
+        : m_metrics(metrics),
+          m_interval(interval),
+          m_rowsPerSample(metrics.GetNCells() + 1),
+          m_capacity(capacity == 0 ? 1 : capacity),
+          m_times(m_capacity),
+          m_queueDepth(m_capacity),
+          m_rows(static_cast<size_t>(m_capacity) * m_rowsPerSample),
+          m_head(0),
+          m_tail(0),
+          m_done(false)
+    {
+        m_file = std::fopen(path.c_str(), "w");
+        NS_ABORT_MSG_IF(m_file == nullptr, "Não foi possível criar " << path);
+        std::fprintf(m_file,
+                     "time_s,cell,txPackets,rxPackets,throughput_Mbps,meanDelay_ms,"
+                     "loss_pct,inFlight,eventQueue\n");
+        m_writer = std::thread(&KpiSampler::WriterLoop, this);
+    }
+
+    ~KpiSampler()
+    {
+        Finish();
+    }
+
+    KpiSampler(const KpiSampler&) = delete;
+    KpiSampler& operator=(const KpiSampler&) = delete;
+
+    /// Primeira amostra em start + interval, depois a cada interval.
+    void Start(Time start)
+    {
+        Simulator::Schedule(start - Simulator::Now() + m_interval, &KpiSampler::Sample, this);
+    }
+
+    /// Espera a thread gravar o que resta no buffer e fecha o arquivo.
+    void Finish()
+    {
+        if (!m_writer.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+        }
+        m_notEmpty.notify_one();
+        m_writer.join();
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+  private:
+    void Sample()
+    {
+        uint64_t slot;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notFull.wait(lock, [this] { return m_head - m_tail < m_capacity; });
+            slot = m_head % m_capacity;
+        }
+
+        // Só o produtor escreve no slot entre m_tail e m_head, sem trava
+        StreamingMetrics::RunningCounters* rows = &m_rows[slot * m_rowsPerSample];
+        StreamingMetrics::RunningCounters& total = rows[m_rowsPerSample - 1];
+        total = StreamingMetrics::RunningCounters();
+        for (uint32_t c = 0; c + 1 < m_rowsPerSample; ++c)
+        {
+            rows[c] = m_metrics.GetCellCounters(c);
+            total.txPackets += rows[c].txPackets;
+            total.rxPackets += rows[c].rxPackets;
+            total.rxBytes += rows[c].rxBytes;
+            total.lostPackets += rows[c].lostPackets;
+            total.delaySum += rows[c].delaySum;
+        }
+        m_times[slot] = Simulator::Now().GetSeconds();
+        const CountingScheduler* scheduler = CountingScheduler::GetActive();
+        m_queueDepth[slot] = scheduler != nullptr ? scheduler->GetStats().depth : 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_head;
+        }
+        m_notEmpty.notify_one();
+
+        Simulator::Schedule(m_interval, &KpiSampler::Sample, this);
+    }
+
+    void WriterLoop()
+    {
+        std::vector<StreamingMetrics::RunningCounters> previous(m_rowsPerSample);
+        double window = m_interval.GetSeconds();
+        while (true)
+        {
+            uint64_t slot;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this] { return m_tail < m_head || m_done; });
+                if (m_tail == m_head)
+                {
+                    return; // m_done e buffer vazio
+                }
+                slot = m_tail % m_capacity;
+            }
+
+            const StreamingMetrics::RunningCounters* rows = &m_rows[slot * m_rowsPerSample];
+            for (uint32_t c = 0; c < m_rowsPerSample; ++c)
+            {
+                const StreamingMetrics::RunningCounters& now = rows[c];
+                const StreamingMetrics::RunningCounters& before = previous[c];
+                uint64_t tx = now.txPackets - before.txPackets;
+                uint64_t rx = now.rxPackets - before.rxPackets;
+                int64_t lost = static_cast<int64_t>(now.lostPackets) -
+                               static_cast<int64_t>(before.lostPackets);
+                double throughputMbps = (now.rxBytes - before.rxBytes) * 8.0 / (window * 1e6);
+                double meanDelayMs =
+                    rx > 0 ? TimeStep(now.delaySum - before.delaySum).GetSeconds() * 1000.0 / rx
+                           : 0.0;
+                double offered = static_cast<double>(rx) + static_cast<double>(lost);
+                double lossPct = offered > 0 ? lost * 100.0 / offered : 0.0;
+                int64_t inFlight = static_cast<int64_t>(now.txPackets) -
+                                   static_cast<int64_t>(now.rxPackets + now.lostPackets);
+
+                char cell[16] = "all";
+                if (c + 1 < m_rowsPerSample)
+                {
+                    std::snprintf(cell, sizeof(cell), "%u", c);
+                }
+                std::fprintf(m_file,
+                             "%.6f,%s,%llu,%llu,%.6f,%.6f,%.4f,%lld,%llu\n",
+                             m_times[slot],
+                             cell,
+                             static_cast<unsigned long long>(tx),
+                             static_cast<unsigned long long>(rx),
+                             throughputMbps,
+                             meanDelayMs,
+                             lossPct,
+                             static_cast<long long>(inFlight),
+                             static_cast<unsigned long long>(m_queueDepth[slot]));
+                previous[c] = now;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_tail;
+            }
+            m_notFull.notify_one();
+        }
+    }
+
+    const StreamingMetrics& m_metrics;
+    Time m_interval;
+    uint32_t m_rowsPerSample; // células + linha global
+    uint32_t m_capacity;
+
+    std::vector<double> m_times;
+    std::vector<uint64_t> m_queueDepth;
+    std::vector<StreamingMetrics::RunningCounters> m_rows;
+    uint64_t m_head; // próxima amostra a escrever (simulação)
+    uint64_t m_tail; // próxima amostra a gravar (thread)
+    bool m_done;
+
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::thread m_writer;
+    std::FILE* m_file;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_SAMPLER_H */
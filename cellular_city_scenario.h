@@ -0,0 +1,765 @@
+/*
+ * cellular_city_scenario.h
+ *
+ * Núcleo comum das simulações da cidade (cellular_city_sim e
+ * cellular_city_multicell_sim):
+ *  - CityTopology: helpers LTE + EPC com o perfil 4g/5g, host remoto ligado
+ *    ao PGW e instalação dos UEs (mobilidade, dispositivo LTE, pilha IP,
+ *    endereço e rota padrão);
+ *  - UplinkCbrTraffic: servidor UDP no host remoto e tráfego CBR de subida
+ *    dos UEs, pelo gerador agrupado ou por um UdpClient por UE;
+ *  - CityMetricsCollector: métricas em fluxo contínuo, FlowMonitor opcional
+ *    (em todos os UEs ou em uma amostra deles) e o resumo impresso no bloco
+ *    RESULTADOS.
+ *
+ * Cada simulação só monta a sua geometria (uma célula ou a grade de
+ * eNodeBs) e a associação dos UEs.
+ */
+
+#ifndef CELLULAR_CITY_SCENARIO_H
+#define CELLULAR_CITY_SCENARIO_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/traffic-control-module.h"
+
+#include "cellular_city_memory.h"
+#include "cellular_city_metrics.h"
+#include "cellular_city_mobility.h"
+#include "cellular_city_traffic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class CityTopology
+{
+  public:
+    /// 1) Helpers LTE + EPC com o perfil da tecnologia ("4g" ou "5g"). O
+    /// modelo de perda ainda pode ser trocado até InstallEnbs().
+    explicit CityTopology(const std::string& tech)
+        : m_tech(tech)
+    {
+        m_lteHelper = CreateObject<LteHelper>();
+        m_epcHelper = CreateObject<PointToPointEpcHelper>();
+        m_lteHelper->SetEpcHelper(m_epcHelper);
+
+        // Ajustes de "perfil" para 4G x 5G (usando o mesmo módulo LTE, mas
+        // com parâmetros diferentes)
+        if (tech == "4g")
+        {
+            // Emular 4G: banda menor
+            m_lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(50)); // RBs
+            m_lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(50));
+        }
+        else if (tech == "5g")
+        {
+            // Emular 5G: mais banda
+            m_lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(100)); // RBs
+            m_lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(100));
+        }
+        else
+        {
+            NS_ABORT_MSG("Valor inválido para --tech (use 4g ou 5g)");
+        }
+    }
+
+    /// 2) Host remoto (Internet) ligado ao PGW por um enlace P2P; no "5G" o
+    /// atraso do núcleo é menor. A rede dos UEs (7.0.0.0/8) é roteada pelo
+    /// enlace.
+    void BuildRemoteHost()
+    {
+        NodeContainer remoteHostContainer;
+        remoteHostContainer.Create(1);
+        m_remoteHost = remoteHostContainer.Get(0);
+        m_internet.Install(remoteHostContainer);
+
+        PointToPointHelper p2ph;
+        p2ph.SetDeviceAttribute("DataRate", StringValue("10Gbps"));
+        p2ph.SetChannelAttribute("Delay", StringValue(m_tech == "4g" ? "10ms" : "2ms"));
+
+        NetDeviceContainer internetDevs = p2ph.Install(m_epcHelper->GetPgwNode(), m_remoteHost);
+        Ipv4AddressHelper ipv4h;
+        ipv4h.SetBase("1.0.0.0", "255.0.0.0");
+        Ipv4InterfaceContainer internetIfaces = ipv4h.Assign(internetDevs);
+        m_remoteAddress = internetIfaces.GetAddress(1);
+        m_remoteDevice = internetDevs.Get(1);
+
+        Ptr<Ipv4StaticRouting> remoteHostStaticRouting =
+            m_ipv4RoutingHelper.GetStaticRouting(m_remoteHost->GetObject<Ipv4>());
+        remoteHostStaticRouting->AddNetworkRouteTo(
+            Ipv4Address("7.0.0.0"), Ipv4Mask("255.0.0.0"), 1);
+    }
+
+    /// Fila de saída do host remoto com espaço para packets pacotes, sem o
+    /// queue disc padrão (FqCoDel, 10240 pacotes): o gerador de descida
+    /// entrega a rajada de uma posição da roda de uma vez ao enlace P2P, e
+    /// DownlinkTraffic limita essa rajada a cerca de 10240 pacotes.
+    void SetRemoteHostQueue(uint64_t packets)
+    {
+        TrafficControlHelper().Uninstall(m_remoteDevice);
+        Ptr<PointToPointNetDevice> dev = DynamicCast<PointToPointNetDevice>(m_remoteDevice);
+        dev->GetQueue()->SetMaxSize(QueueSize(QueueSizeUnit::PACKETS, packets));
+    }
+
+    /// Velocidade máxima (m/s) do passeio aleatório dos UEs.
+    static constexpr double kUeMaxSpeed = 2.0;
+
+    /// TypeId do modelo de mobilidade dos UEs: "walk" (RandomWalk2d do ns-3)
+    /// ou "lazy" (LazyRandomWalkMobilityModel, sem eventos).
+    static std::string UeMobilityType(const std::string& model)
+    {
+        if (model == "walk")
+        {
+            return "ns3::RandomWalk2dMobilityModel";
+        }
+        if (model == "lazy")
+        {
+            return "ns3::LazyRandomWalkMobilityModel";
+        }
+        NS_ABORT_MSG("Valor inválido para --ueMobility (use walk ou lazy)");
+        return "";
+    }
+
+    /// Mobilidade dos UEs com as posições iniciais de positions.
+    static void InstallUeMobility(const NodeContainer& ues,
+                                  Ptr<PositionAllocator> positions,
+                                  double half,
+                                  const std::string& model = "walk")
+    {
+        MobilityHelper mobilityUe;
+        mobilityUe.SetPositionAllocator(positions);
+        mobilityUe.SetMobilityModel(
+            UeMobilityType(model),
+            "Bounds", RectangleValue(Rectangle(-half, half, -half, half)),
+            "Speed", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=2.0]"));
+        mobilityUe.Install(ues);
+    }
+
+    /**
+     * Perfil "lean" (--leanUe) para os UEs instalados depois desta chamada:
+     * pilha só IPv4 (sem Ipv6L3Protocol, ICMPv6 e roteamento IPv6) e só
+     * roteamento estático (sem Ipv4ListRouting e Ipv4GlobalRouting), o
+     * bastante para a rota padrão até o PGW. O host remoto não muda.
+     */
+    void SetLeanUes()
+    {
+        m_ueInternet.SetIpv6StackInstall(false);
+        m_ueInternet.SetRoutingHelper(m_ipv4RoutingHelper);
+    }
+
+    NetDeviceContainer InstallEnbs(const NodeContainer& enbs)
+    {
+        return m_lteHelper->InstallEnbDevice(enbs);
+    }
+
+    /// Dispositivos LTE, pilha IP, endereços e rota padrão (-> PGW) dos UEs,
+    /// uma etapa de cada vez sobre todos os UEs. Os UEs já têm mobilidade.
+    /// Com footprint, marca a memória das duas etapas.
+    void InstallUes(const NodeContainer& ues, MemoryFootprint* footprint = nullptr)
+    {
+        m_ueDevs = m_lteHelper->InstallUeDevice(ues);
+        if (footprint)
+        {
+            footprint->Mark("UEs: dispositivos LTE");
+        }
+        m_ueInternet.Install(ues);
+        m_ueIfaces = m_epcHelper->AssignUeIpv4Address(NetDeviceContainer(m_ueDevs));
+
+        Ipv4Address gateway = m_epcHelper->GetUeDefaultGatewayAddress();
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            SetDefaultRoute(ues.Get(i), gateway);
+        }
+        if (footprint)
+        {
+            footprint->Mark("UEs: pilha IP e enderecos");
+        }
+    }
+
+    Ptr<LteHelper> GetLteHelper() const { return m_lteHelper; }
+    Ptr<PointToPointEpcHelper> GetEpcHelper() const { return m_epcHelper; }
+    Ptr<Node> GetRemoteHost() const { return m_remoteHost; }
+    Ipv4Address GetRemoteAddress() const { return m_remoteAddress; }
+    const NetDeviceContainer& GetUeDevices() const { return m_ueDevs; }
+    const Ipv4InterfaceContainer& GetUeInterfaces() const { return m_ueIfaces; }
+
+  private:
+    void SetDefaultRoute(Ptr<Node> ue, Ipv4Address gateway)
+    {
+        Ptr<Ipv4StaticRouting> ueStaticRouting =
+            m_ipv4RoutingHelper.GetStaticRouting(ue->GetObject<Ipv4>());
+        ueStaticRouting->SetDefaultRoute(gateway, 1);
+    }
+
+    std::string m_tech;
+    Ptr<LteHelper> m_lteHelper;
+    Ptr<PointToPointEpcHelper> m_epcHelper;
+    Ptr<Node> m_remoteHost;
+    Ipv4Address m_remoteAddress;
+    Ptr<NetDevice> m_remoteDevice;
+    InternetStackHelper m_internet;
+    InternetStackHelper m_ueInternet;
+    Ipv4StaticRoutingHelper m_ipv4RoutingHelper;
+    NetDeviceContainer m_ueDevs;
+    Ipv4InterfaceContainer m_ueIfaces;
+};
+
+/**
+ * Tráfego sensível a atraso (UDP CBR) dos UEs -> host remoto. Por padrão um
+ * único gerador envia os pacotes de todos os UEs (um evento por posição da
+ * roda a cada intervalo); com pooled = false instala um UdpClient por UE.
+ */
+class UplinkCbrTraffic
+{
+  public:
+    UplinkCbrTraffic(Ptr<Node> remoteHost,
+                     Ipv4Address remoteAddress,
+                     uint16_t port,
+                     Time interval,
+                     uint32_t packetSize,
+                     bool pooled,
+                     uint32_t nSlots)
+        : m_remoteHost(remoteHost),
+          m_remoteAddress(remoteAddress),
+          m_port(port),
+          m_interval(interval),
+          m_packetSize(packetSize),
+          m_pooled(pooled),
+          m_pooledTraffic(InetSocketAddress(remoteAddress, port), interval, packetSize, nSlots)
+    {
+    }
+
+    /// UEs representados por cada nó de ues (agrupamentos da simulação
+    /// multi-célula): o nó i envia pacotes de weights[i] * packetSize bytes
+    /// e o seu fluxo conta weights[i] vezes nas métricas. Chamar antes de
+    /// Install().
+    void SetWeights(const std::vector<uint32_t>& weights)
+    {
+        m_weights = weights;
+    }
+
+    /// Períodos de fala e silêncio por UE (perfil voip), com ueKeys[i] a
+    /// chave do UE i de Install(). O UdpClient não tem como calar, então a
+    /// voz sempre usa o gerador agrupado. Chamar antes de Install().
+    void SetVoice(const std::vector<uint64_t>& ueKeys)
+    {
+        m_voice = std::make_unique<VoiceActivity>(1);
+        for (uint64_t key : ueKeys)
+        {
+            m_voice->AddSource(key);
+        }
+        m_pooled = true;
+        m_pooledTraffic.SetVoiceActivity(m_voice.get());
+    }
+
+    /// Servidor UDP no host remoto (ativo de 0.1 s, ou de start se antes,
+    /// até stop) e as fontes dos UEs, na ordem de ues, enviando de start até
+    /// stop.
+    void Install(const NodeContainer& ues, Time start, Time stop)
+    {
+        NS_ASSERT(m_weights.empty() || m_weights.size() == ues.GetN());
+        UdpServerHelper udpServer(m_port);
+        m_serverApps = udpServer.Install(m_remoteHost);
+        m_serverApps.Start(std::min(Seconds(0.1), start));
+        m_serverApps.Stop(stop);
+
+        if (m_pooled)
+        {
+            for (uint32_t i = 0; i < ues.GetN(); ++i)
+            {
+                m_pooledTraffic.AddSource(ues.Get(i), GetPacketSize(i));
+            }
+            m_pooledTraffic.Start(start);
+            m_pooledTraffic.Stop(stop);
+            return;
+        }
+
+        UdpClientHelper udpClient(m_remoteAddress, m_port);
+        udpClient.SetAttribute("MaxPackets", UintegerValue(0xFFFFFFFF));
+        udpClient.SetAttribute("Interval", TimeValue(m_interval));
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            udpClient.SetAttribute("PacketSize", UintegerValue(GetPacketSize(i)));
+            m_clientApps.Add(udpClient.Install(ues.Get(i)));
+        }
+        m_clientApps.Start(start);
+        m_clientApps.Stop(stop);
+    }
+
+    /// Registra um fluxo por UE (endereços em ueIfaces, na ordem de
+    /// Install()) e liga os traces de envio e de recepção.
+    void ConnectMetrics(StreamingMetrics& metrics, const Ipv4InterfaceContainer& ueIfaces)
+    {
+        for (uint32_t i = 0; i < ueIfaces.GetN(); ++i)
+        {
+            uint32_t flow = metrics.AddFlow(ueIfaces.GetAddress(i));
+            if (!m_weights.empty())
+            {
+                metrics.SetFlowWeight(flow, m_weights[i]);
+            }
+            if (!m_pooled)
+            {
+                metrics.ConnectClient(m_clientApps.Get(i), flow);
+            }
+        }
+        if (m_pooled)
+        {
+            // índice da fonte == índice do fluxo (mesma ordem dos UEs)
+            m_pooledTraffic.SetTxCallback(MakeCallback(&StreamingMetrics::NotifyTx, &metrics));
+        }
+        metrics.ConnectServer(m_serverApps.Get(0));
+    }
+
+  private:
+    uint32_t GetPacketSize(uint32_t ue) const
+    {
+        return m_weights.empty() ? m_packetSize : m_weights[ue] * m_packetSize;
+    }
+
+    Ptr<Node> m_remoteHost;
+    Ipv4Address m_remoteAddress;
+    uint16_t m_port;
+    Time m_interval;
+    uint32_t m_packetSize;
+    bool m_pooled;
+    PooledCbrTraffic m_pooledTraffic;
+    std::unique_ptr<VoiceActivity> m_voice;
+    ApplicationContainer m_serverApps;
+    ApplicationContainer m_clientApps;
+    std::vector<uint32_t> m_weights;
+};
+
+/**
+ * Perfil de tráfego (--traffic): sentidos, intervalo e tamanho dos pacotes.
+ *  - ul: CBR de subida UE -> host remoto (intervalo e tamanho da simulação)
+ *  - dl: o mesmo CBR no sentido host remoto -> UE
+ *  - voip: voz nos dois sentidos, 60 bytes a cada 20 ms durante os períodos
+ *    de fala de cada UE (VoiceActivity)
+ *  - video: quadros de vídeo em rajada na descida (DownlinkTraffic::SetVideo)
+ */
+struct TrafficProfile
+{
+    bool uplink;
+    bool downlink;
+    bool video;
+    bool voice;          // liga/desliga por talkspurts
+    double interval;     // s
+    uint32_t packetSize; // bytes, com o SeqTsHeader
+
+    static TrafficProfile Parse(const std::string& name, double interval, uint32_t packetSize)
+    {
+        if (name == "ul")
+        {
+            return {true, false, false, false, interval, packetSize};
+        }
+        if (name == "dl")
+        {
+            return {false, true, false, false, interval, packetSize};
+        }
+        if (name == "voip")
+        {
+            return {true, true, false, true, 0.02, 60};
+        }
+        if (name == "video")
+        {
+            return {false, true, true, false, 1.0 / 30.0, packetSize};
+        }
+        NS_ABORT_MSG("Valor inválido para --traffic (use ul, dl, voip ou video)");
+        return {};
+    }
+};
+
+/**
+ * Tráfego de descida host remoto -> UEs, de um único gerador no host remoto
+ * (PooledDownlinkTraffic): pacotes de tamanho fixo a cada intervalo ou, com
+ * SetVideo(), quadros de vídeo em rajada.
+ */
+class DownlinkTraffic
+{
+  public:
+    /// Quadros de vídeo (um por intervalo; 30/s no perfil video):
+    /// log-normal com média de 4000 bytes (cerca de 1 Mbps por UE),
+    /// limitados a 30000 bytes e enviados em pacotes de até 1200 bytes.
+    static constexpr double kVideoFrameMeanBytes = 4000.0;
+    static constexpr double kVideoFrameSigma = 0.5;
+    static constexpr uint32_t kVideoMaxFrameBytes = 30000;
+    static constexpr uint32_t kVideoPacketBytes = 1200;
+    /// Maior rajada de uma posição da roda na fila do host remoto (o limite
+    /// do FqCoDel que ela substitui); cerca de 10 ms do enlace de 10 Gbps.
+    static constexpr uint64_t kMaxRemoteQueuePackets = 10240;
+
+    DownlinkTraffic(CityTopology& topology,
+                    uint16_t port,
+                    Time interval,
+                    uint32_t packetSize,
+                    uint32_t nSlots)
+        : m_topology(topology),
+          m_packetSize(packetSize),
+          m_source(topology.GetRemoteHost(), port, interval, nSlots)
+    {
+    }
+
+    /// Como UplinkCbrTraffic::SetWeights(). Chamar antes de Install().
+    void SetWeights(const std::vector<uint32_t>& weights)
+    {
+        m_weights = weights;
+    }
+
+    /// Como UplinkCbrTraffic::SetVoice(). Chamar antes de Install().
+    void SetVoice(const std::vector<uint64_t>& ueKeys)
+    {
+        m_voice = std::make_unique<VoiceActivity>(2);
+        for (uint64_t key : ueKeys)
+        {
+            m_voice->AddSource(key);
+        }
+        m_source.SetVoiceActivity(m_voice.get());
+    }
+
+    /// Quadros de vídeo no lugar dos pacotes fixos; cada UE sorteia os
+    /// tamanhos dos seus quadros de uma variável própria. Chamar antes de
+    /// Install().
+    void SetVideo()
+    {
+        m_source.SetBursty(kVideoMaxFrameBytes, kVideoPacketBytes);
+        m_video = true;
+    }
+
+    /// Streams dos tamanhos dos quadros (com SetVideo()), streams[i] para o
+    /// UE i de Install(). Chamar depois de Install(). Devolve quantos usou.
+    int64_t AssignStreams(const std::vector<int64_t>& streams)
+    {
+        NS_ASSERT(m_frameBytes.empty() || streams.size() == m_frameBytes.size());
+        for (uint32_t i = 0; i < m_frameBytes.size(); ++i)
+        {
+            m_frameBytes[i]->SetStream(streams[i]);
+        }
+        return m_frameBytes.size();
+    }
+
+    /// Sockets de recepção dos UEs (na ordem de ues) e fontes, enviando de
+    /// start até stop. Os UEs já têm endereço.
+    void Install(const NodeContainer& ues, Time start, Time stop)
+    {
+        NS_ASSERT(m_weights.empty() || m_weights.size() == ues.GetN());
+        // Uma posição da roda entrega a sua rajada de uma vez à fila do host
+        // remoto. Se as rajadas passarem de kMaxRemoteQueuePackets, as fontes
+        // são espalhadas por mais posições, no lugar de uma fila do tamanho
+        // da rajada.
+        uint64_t burst = 0;
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            burst += m_source.GetBurstPackets(m_weights.empty() ? 1 : m_weights[i]);
+        }
+        uint64_t slots = (burst + kMaxRemoteQueuePackets - 1) / kMaxRemoteQueuePackets;
+        if (slots > m_source.GetNSlots())
+        {
+            m_source.SetNSlots(slots);
+        }
+
+        const Ipv4InterfaceContainer& ueIfaces = m_topology.GetUeInterfaces();
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            uint32_t weight = m_weights.empty() ? 1 : m_weights[i];
+            Ptr<LogNormalRandomVariable> frame;
+            if (m_video)
+            {
+                frame = CreateObject<LogNormalRandomVariable>();
+                frame->SetAttribute("Mu", DoubleValue(std::log(kVideoFrameMeanBytes) -
+                                                      kVideoFrameSigma * kVideoFrameSigma / 2.0));
+                frame->SetAttribute("Sigma", DoubleValue(kVideoFrameSigma));
+                m_frameBytes.push_back(frame);
+            }
+            m_source.AddSource(ues.Get(i), ueIfaces.GetAddress(i), weight * m_packetSize, weight,
+                               frame);
+        }
+        m_topology.SetRemoteHostQueue(std::max<uint64_t>(m_source.GetMaxBurstPackets(), 100));
+        m_source.Start(start);
+        m_source.Stop(stop);
+    }
+
+    /// Porta de origem do gerador no host remoto (a dos fluxos de descida).
+    uint16_t GetSourcePort() const { return m_source.GetSourcePort(); }
+
+    /// Um fluxo por UE (índice da fonte == índice do fluxo), com a porta de
+    /// recepção do UE, e as callbacks de envio e de recepção.
+    void ConnectMetrics(StreamingMetrics& metrics, const Ipv4InterfaceContainer& ueIfaces)
+    {
+        for (uint32_t i = 0; i < ueIfaces.GetN(); ++i)
+        {
+            uint32_t flow = metrics.AddFlow(ueIfaces.GetAddress(i));
+            metrics.SetFlowPort(flow, m_source.GetPort());
+            if (!m_weights.empty())
+            {
+                metrics.SetFlowWeight(flow, m_weights[i]);
+            }
+        }
+        m_source.SetTxCallback(MakeCallback(&StreamingMetrics::NotifyTx, &metrics));
+        m_source.SetRxCallback(MakeCallback(&StreamingMetrics::NotifyRx, &metrics));
+    }
+
+  private:
+    CityTopology& m_topology;
+    uint32_t m_packetSize;
+    PooledDownlinkTraffic m_source;
+    std::unique_ptr<VoiceActivity> m_voice;
+    bool m_video = false;
+    std::vector<Ptr<RandomVariableStream>> m_frameBytes; // um por UE, com SetVideo()
+    std::vector<uint32_t> m_weights;
+};
+
+/**
+ * Métricas da simulação: contadores globais e histogramas fixos atualizados
+ * durante a simulação (StreamingMetrics). O FlowMonitor, com histogramas por
+ * fluxo, só é instalado com EnablePerFlowStats().
+ */
+class CityMetricsCollector
+{
+  public:
+    /// Indicadores do bloco RESULTADOS.
+    struct Summary
+    {
+        double meanDelayMs    = 0.0;
+        double jitterMs       = 0.0;
+        double throughputMbps = 0.0;
+        double lossRatePct    = 0.0;
+    };
+
+    /// Somas por fluxo da amostra do FlowMonitor (--monitorFraction),
+    /// somáveis entre partições. Cada fluxo medido contribui com o seu
+    /// throughput (Mbps), atraso médio (ms) e taxa de perda (%).
+    struct SampleSums
+    {
+        double n             = 0.0;
+        double throughput    = 0.0;
+        double throughputSq  = 0.0;
+        double delay         = 0.0;
+        double delaySq       = 0.0;
+        double loss          = 0.0;
+        double lossSq        = 0.0;
+
+        static constexpr uint32_t kFields = 7;
+        double* Data() { return &n; }
+    };
+
+    StreamingMetrics& GetMetrics() { return m_metrics; }
+
+    /// FlowMonitor em todos os nós; os fluxos só são medidos a partir de
+    /// start (o fim do aquecimento).
+    void EnablePerFlowStats(Time start = Seconds(0))
+    {
+        m_flowmon.SetMonitorAttribute("StartTime", TimeValue(start));
+        m_monitor = m_flowmon.InstallAll();
+    }
+
+    /**
+     * FlowMonitor só no host remoto e em uma fração dos UEs. A escolha de
+     * cada UE depende só do seu índice e de --RngRun (não consome números
+     * aleatórios do cenário), então a mesma execução mede os mesmos UEs.
+     * Devolve o número de UEs monitorados.
+     */
+    uint32_t EnableSampledFlowStats(const NodeContainer& ues,
+                                    Ptr<Node> remoteHost,
+                                    double fraction,
+                                    Time start = Seconds(0))
+    {
+        uint64_t run = RngSeedManager::GetRun();
+        NodeContainer sampled;
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            // splitmix64 de (run, i) -> uniforme em [0, 1)
+            uint64_t z = (run << 32) + i + 0x9E3779B97F4A7C15ULL;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z ^= z >> 31;
+            if ((z >> 11) * (1.0 / 9007199254740992.0) < fraction)
+            {
+                sampled.Add(ues.Get(i));
+            }
+        }
+        sampled.Add(remoteHost);
+
+        m_flowmon.SetMonitorAttribute("StartTime", TimeValue(start));
+        m_monitor = m_flowmon.Install(sampled);
+        m_sampled = true;
+        return sampled.GetN() - 1;
+    }
+
+    bool IsSampled() const { return m_sampled; }
+
+    /// Somas dos fluxos de subida (UE -> remoteAddress) medidos pela
+    /// amostra, com as taxas calculadas sobre window segundos.
+    SampleSums GetSampleSums(Ipv4Address remoteAddress, double window)
+    {
+        SampleSums sums;
+        if (!m_monitor)
+        {
+            return sums;
+        }
+        m_monitor->CheckForLostPackets();
+        Ptr<Ipv4FlowClassifier> classifier =
+            DynamicCast<Ipv4FlowClassifier>(m_flowmon.GetClassifier());
+        for (const auto& entry : m_monitor->GetFlowStats())
+        {
+            if (classifier->FindFlow(entry.first).destinationAddress != remoteAddress)
+            {
+                continue;
+            }
+            const FlowMonitor::FlowStats& fs = entry.second;
+            double throughput = fs.rxBytes * 8.0 / (window * 1e6);
+            double delay =
+                fs.rxPackets > 0 ? fs.delaySum.GetSeconds() * 1000.0 / fs.rxPackets : 0.0;
+            double offered = static_cast<double>(fs.rxPackets) + fs.lostPackets;
+            double loss = offered > 0 ? fs.lostPackets * 100.0 / offered : 0.0;
+
+            sums.n += 1.0;
+            sums.throughput += throughput;
+            sums.throughputSq += throughput * throughput;
+            sums.delay += delay;
+            sums.delaySq += delay * delay;
+            sums.loss += loss;
+            sums.lossSq += loss * loss;
+        }
+        return sums;
+    }
+
+    /**
+     * Linhas do bloco RESULTADOS com as estimativas da amostra e a
+     * meia-largura do IC de 95% (normal, com correção de população finita
+     * para nUes fluxos). O throughput total é nUes vezes a média por fluxo.
+     */
+    static void PrintSampleEstimate(std::ostream& os, const SampleSums& sums, uint32_t nUes)
+    {
+        os << "Fluxos na amostra:         " << sums.n << " de " << nUes << std::endl;
+        if (sums.n < 2)
+        {
+            return;
+        }
+        double fpc = std::sqrt(std::max(0.0, 1.0 - sums.n / nUes));
+        auto halfWidth = [&sums, fpc](double sum, double sumSq) {
+            double mean = sum / sums.n;
+            double var = std::max(0.0, (sumSq - sums.n * mean * mean) / (sums.n - 1));
+            return 1.96 * std::sqrt(var / sums.n) * fpc;
+        };
+        os << "Throughput amostra (Mbps): " << nUes * sums.throughput / sums.n << " +- "
+           << nUes * halfWidth(sums.throughput, sums.throughputSq) << std::endl;
+        os << "Atraso amostra (ms):       " << sums.delay / sums.n << " +- "
+           << halfWidth(sums.delay, sums.delaySq) << std::endl;
+        os << "Perda amostra (%):         " << sums.loss / sums.n << " +- "
+           << halfWidth(sums.loss, sums.lossSq) << std::endl;
+    }
+
+    /// Grava o XML do FlowMonitor, se instalado.
+    void WritePerFlowStats(const std::string& fileName)
+    {
+        if (m_monitor)
+        {
+            m_monitor->CheckForLostPackets();
+            m_monitor->SerializeToXmlFile(fileName, true, true);
+        }
+    }
+
+    /// Linha de log de um fluxo (throughput, atraso médio, pacotes); simTime
+    /// é a janela de medida.
+    std::string DescribeFlow(uint32_t flow, Ipv4Address remoteAddress, double simTime) const
+    {
+        const StreamingMetrics::FlowCounters& fs = m_metrics.GetFlow(flow);
+
+        double throughputMbps = (fs.rxBytes * 8.0) / (simTime * 1e6);
+        double meanDelayMs = 0.0;
+        if (fs.rxPackets > 0)
+        {
+            meanDelayMs = (TimeStep(fs.delaySum).GetSeconds() / fs.rxPackets) * 1000.0;
+        }
+
+        std::ostringstream os;
+        os << "Flow " << flow + 1 << " (" << m_metrics.GetFlowAddress(flow) << " -> "
+           << remoteAddress << "): "
+           << "Throughput = " << throughputMbps << " Mbps, "
+           << "Atraso médio = " << meanDelayMs << " ms, "
+           << "RxPackets = " << fs.rxPackets << ", "
+           << "LostPackets = " << StreamingMetrics::GetLostPackets(fs);
+        return os.str();
+    }
+
+    /// Indicadores a partir dos totais (locais ou já reduzidos entre
+    /// processos). jitterSum de cada fluxo é a soma das variações de atraso
+    /// entre pacotes consecutivos.
+    static Summary Summarize(const StreamingMetrics::Totals& totals, double simTime)
+    {
+        Summary s;
+        if (totals.rxPackets > 0)
+        {
+            double meanDelay  = totals.delaySum / (double)totals.rxPackets; // s
+            double meanJitter = 0.0;
+            if (totals.rxPackets > 1)
+            {
+                // Aproximação: jitter médio = jitterSum_total / (N-1)
+                meanJitter = totals.jitterSum / (double)(totals.rxPackets - 1);
+            }
+
+            s.meanDelayMs    = meanDelay  * 1000.0;
+            s.jitterMs       = meanJitter * 1000.0;
+            s.throughputMbps = (totals.rxBytes * 8.0) / (simTime * 1e6);
+        }
+
+        uint64_t offered = totals.rxPackets + totals.lostPackets;
+        if (offered > 0)
+        {
+            s.lossRatePct = (double)totals.lostPackets * 100.0 / (double)offered;
+        }
+        return s;
+    }
+
+    /**
+     * Linhas de indicadores do bloco RESULTADOS, comuns às duas simulações.
+     * suffix vai depois de cada rótulo (" descida" para o segundo sentido de
+     * --traffic=voip), para que o parser dos blocos (cellular_city_runner.h)
+     * não troque os valores de um sentido pelos do outro.
+     */
+    void PrintKpis(std::ostream& os,
+                   const StreamingMetrics::Totals& totals,
+                   double simTime,
+                   const std::string& suffix = "")
+    {
+        auto label = [&](const std::string& name) -> std::ostream& {
+            std::string text = name + suffix + ":";
+            return os << text << std::string(text.size() < 27 ? 27 - text.size() : 1, ' ');
+        };
+        Summary s = Summarize(totals, simTime);
+        label("Atraso medio (ms)") << s.meanDelayMs << std::endl;
+        label("Atraso p95 (ms)") << m_metrics.GetDelayHistogram().Quantile(0.95) * 1000.0 << std::endl;
+        label("Atraso p99 (ms)") << m_metrics.GetDelayHistogram().Quantile(0.99) * 1000.0 << std::endl;
+        label("Jitter medio (ms)") << s.jitterMs << std::endl;
+        label("Throughput total (Mbps)") << s.throughputMbps << std::endl;
+        label("Taxa de perda (%)") << s.lossRatePct << std::endl;
+        label("Pacotes recebidos") << totals.rxPackets << std::endl;
+        label("Pacotes perdidos") << totals.lostPackets << std::endl;
+    }
+
+  private:
+    StreamingMetrics m_metrics;
+    FlowMonitorHelper m_flowmon;
+    Ptr<FlowMonitor> m_monitor;
+    bool m_sampled = false;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_SCENARIO_H */
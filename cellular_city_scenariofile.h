@@ -0,0 +1,270 @@
+/*
+ * cellular_city_scenariofile.h
+ *
+ * Arquivo de cenário da simulação multi-célula (--scenario /
+ * --saveScenario): posições dos sites, azimute do setor 0 de cada site e,
+ * opcionalmente, a posição inicial de cada UE (o que já traz a densidade dos
+ * pontos de concentração de uma cidade real). O arquivo é mapeado em
+ * memória (mmap) e as colunas são lidas direto do mapeamento; a conversão
+ * das posições dos UEs e a filtragem pelo bloco do processo são feitas em
+ * paralelo, em faixas contíguas.
+ *
+ * Formato binário colunar (versão 2, little-endian):
+ *
+ *   char    magic[8]   "CCSCENAR"
+ *   uint32  version    2
+ *   uint32  nSites
+ *   uint32  nUes       0: UEs sorteados como sem cenário (--nUes)
+ *   uint32  reserved   0
+ *   double  areaSize   m (quadrado centrado na origem)
+ *   double  siteX[nSites], siteY[nSites], siteZ[nSites]   m
+ *   double  siteAzimuth[nSites]                           graus
+ *   double  ueX[nUes], ueY[nUes]                          m
+ *
+ * Todas as colunas são double, então --saveScenario grava as posições sem
+ * arredondamento e um cenário gravado reproduz a execução que o gravou. A
+ * versão 1 guardava o azimute e os UEs em float.
+ */
+
+#ifndef CELLULAR_CITY_SCENARIOFILE_H
+#define CELLULAR_CITY_SCENARIOFILE_H
+
+#include "ns3/abort.h"
+#include "ns3/vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+class ScenarioFile
+{
+  public:
+    static constexpr char kMagic[8] = {'C', 'C', 'S', 'C', 'E', 'N', 'A', 'R'};
+    static constexpr uint32_t kVersion = 2;
+    static constexpr size_t kHeaderSize = 32;
+    static constexpr double kUeHeight = 1.5; // m
+
+    /// Mapeia e confere o arquivo (tamanho, magic e versão).
+    explicit ScenarioFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        NS_ABORT_MSG_IF(fd < 0, "Não foi possível abrir " << path);
+        struct stat st;
+        NS_ABORT_MSG_IF(fstat(fd, &st) != 0 || st.st_size < (off_t)kHeaderSize,
+                        path << " não é um arquivo de cenário");
+        m_size = st.st_size;
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        NS_ABORT_MSG_IF(data == MAP_FAILED, "Não foi possível mapear " << path);
+        m_data = static_cast<const char*>(data);
+
+        NS_ABORT_MSG_IF(std::memcmp(m_data, kMagic, sizeof(kMagic)) != 0,
+                        path << " não é um arquivo de cenário");
+        uint32_t version = Read<uint32_t>(8);
+        NS_ABORT_MSG_IF(version != kVersion, path << ": versão " << version << " não suportada");
+        m_nSites = Read<uint32_t>(12);
+        m_nUes = Read<uint32_t>(16);
+        m_areaSize = Read<double>(24);
+        NS_ABORT_MSG_IF(m_nSites == 0 || m_nSites > 65535,
+                        path << ": número de sites inválido (" << m_nSites << ")");
+        NS_ABORT_MSG_IF(m_size != FileSize(m_nSites, m_nUes), path << " truncado");
+
+        // Colunas alinhadas: o cabeçalho e as colunas têm tamanho múltiplo de 8
+        m_siteX = reinterpret_cast<const double*>(m_data + kHeaderSize);
+        m_siteY = m_siteX + m_nSites;
+        m_siteZ = m_siteY + m_nSites;
+        m_siteAzimuth = m_siteZ + m_nSites;
+        m_ueX = m_siteAzimuth + m_nSites;
+        m_ueY = m_ueX + m_nUes;
+        // Os UEs são lidos em sequência
+        madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+    }
+
+    ~ScenarioFile()
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    ScenarioFile(const ScenarioFile&) = delete;
+    ScenarioFile& operator=(const ScenarioFile&) = delete;
+
+    uint32_t GetNSites() const { return m_nSites; }
+    uint32_t GetNUes() const { return m_nUes; }
+    double GetAreaSize() const { return m_areaSize; }
+
+    std::vector<Vector> GetSitePositions() const
+    {
+        std::vector<Vector> positions(m_nSites);
+        for (uint32_t i = 0; i < m_nSites; ++i)
+        {
+            positions[i] = Vector(m_siteX[i], m_siteY[i], m_siteZ[i]);
+        }
+        return positions;
+    }
+
+    std::vector<double> GetSiteAzimuths() const
+    {
+        return std::vector<double>(m_siteAzimuth, m_siteAzimuth + m_nSites);
+    }
+
+    /**
+     * Posições dos UEs para os quais keep(x, y) vale, na ordem do arquivo,
+     * em positions; keys recebe o índice de cada um no arquivo. keep é
+     * chamado de várias threads ao mesmo tempo (deve só ler). Todo UE deve
+     * estar dentro da área.
+     */
+    template <typename Keep>
+    void ReadUes(Keep keep,
+                 std::vector<Vector>& positions,
+                 std::vector<uint64_t>& keys,
+                 uint32_t nThreads = std::thread::hardware_concurrency()) const
+    {
+        // Faixas de pelo menos 64k UEs: abaixo disso as threads não pagam
+        nThreads = std::max<uint32_t>(1, std::min<uint32_t>(nThreads, m_nUes / 65536));
+        std::vector<std::vector<Vector>> chunkPositions(nThreads);
+        std::vector<std::vector<uint64_t>> chunkKeys(nThreads);
+        std::vector<uint64_t> outside(nThreads, 0);
+        double half = m_areaSize / 2.0;
+        auto work = [&](uint32_t t) {
+            uint64_t first = (uint64_t)m_nUes * t / nThreads;
+            uint64_t last = (uint64_t)m_nUes * (t + 1) / nThreads;
+            for (uint64_t i = first; i < last; ++i)
+            {
+                double x = m_ueX[i];
+                double y = m_ueY[i];
+                if (std::abs(x) > half || std::abs(y) > half)
+                {
+                    ++outside[t];
+                }
+                else if (keep(x, y))
+                {
+                    chunkPositions[t].push_back(Vector(x, y, kUeHeight));
+                    chunkKeys[t].push_back(i);
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (uint32_t t = 1; t < nThreads; ++t)
+        {
+            threads.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& th : threads)
+        {
+            th.join();
+        }
+        uint64_t nOutside = 0;
+        for (uint64_t n : outside)
+        {
+            nOutside += n;
+        }
+        NS_ABORT_MSG_IF(nOutside > 0, nOutside << " UEs do cenário fora da área");
+
+        size_t total = 0;
+        for (const std::vector<Vector>& c : chunkPositions)
+        {
+            total += c.size();
+        }
+        positions.reserve(positions.size() + total);
+        keys.reserve(keys.size() + total);
+        for (uint32_t t = 0; t < nThreads; ++t)
+        {
+            positions.insert(positions.end(), chunkPositions[t].begin(), chunkPositions[t].end());
+            keys.insert(keys.end(), chunkKeys[t].begin(), chunkKeys[t].end());
+        }
+    }
+
+    static size_t FileSize(uint32_t nSites, uint32_t nUes)
+    {
+        return kHeaderSize + (size_t)nSites * 4 * sizeof(double) + (size_t)nUes * 2 * sizeof(double);
+    }
+
+    /// Grava sites (com azimuths[i] para sites[i]) e UEs no formato de
+    /// --scenario.
+    static void Save(const std::string& path,
+                     double areaSize,
+                     const std::vector<Vector>& sites,
+                     const std::vector<double>& azimuths,
+                     const std::vector<Vector>& ues)
+    {
+        NS_ABORT_MSG_IF(azimuths.size() != sites.size(),
+                        azimuths.size() << " azimutes para " << sites.size() << " sites");
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        NS_ABORT_MSG_IF(!os, "Não foi possível criar " << path);
+        os.write(kMagic, sizeof(kMagic));
+        Put<uint32_t>(os, kVersion);
+        Put<uint32_t>(os, sites.size());
+        Put<uint32_t>(os, ues.size());
+        Put<uint32_t>(os, 0);
+        Put<double>(os, areaSize);
+        for (const Vector& s : sites)
+        {
+            Put<double>(os, s.x);
+        }
+        for (const Vector& s : sites)
+        {
+            Put<double>(os, s.y);
+        }
+        for (const Vector& s : sites)
+        {
+            Put<double>(os, s.z);
+        }
+        for (double a : azimuths)
+        {
+            Put<double>(os, a);
+        }
+        for (const Vector& u : ues)
+        {
+            Put<double>(os, u.x);
+        }
+        for (const Vector& u : ues)
+        {
+            Put<double>(os, u.y);
+        }
+        NS_ABORT_MSG_IF(!os, "Erro de escrita em " << path);
+    }
+
+  private:
+    template <typename T>
+    T Read(size_t offset) const
+    {
+        T value;
+        std::memcpy(&value, m_data + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    static void Put(std::ofstream& os, T value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    uint32_t m_nSites = 0;
+    uint32_t m_nUes = 0;
+    double m_areaSize = 0.0;
+    const double* m_siteX = nullptr;
+    const double* m_siteY = nullptr;
+    const double* m_siteZ = nullptr;
+    const double* m_siteAzimuth = nullptr;
+    const double* m_ueX = nullptr;
+    const double* m_ueY = nullptr;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_SCENARIOFILE_H */
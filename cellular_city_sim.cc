@@ -12,8 +12,11 @@
  * Depois compare os valores impressos.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <cmath>
+#include <memory>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -24,27 +27,164 @@
 #include "ns3/applications-module.h"
 #include "ns3/flow-monitor-module.h"
 
+#include "cellular_city_arena.h"
+#include "cellular_city_memory.h"
+#include "cellular_city_metrics.h"
+#include "cellular_city_pathloss.h"
+#include "cellular_city_sampler.h"
+#include "cellular_city_scenario.h"
+#include "cellular_city_scheduler.h"
+#include "cellular_city_statsout.h"
+#include "cellular_city_steadystate.h"
+#include "cellular_city_streams.h"
+#include "cellular_city_timing.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("CellularCitySim");
 
+// Substituição do operator new/delete (só com -DCELLULAR_CITY_PACKET_ARENA); a
+// arena só é ligada com --packetArena
+CELLULAR_CITY_ARENA_OPERATORS
+
 int
 main(int argc, char *argv[])
 {
     // Parâmetros que você pode ajustar
-    uint16_t nUes      = 50;     // número de usuários
+    uint32_t nUes      = 50;     // número de usuários
     double   simTime   = 30.0;   // duração em segundos
     std::string tech   = "4g";   // "4g" ou "5g"
     bool verbose       = true;
+    bool perFlowStats  = false;  // FlowMonitor com histogramas por fluxo
+    double monitorFraction = 1.0;   // fração dos UEs com FlowMonitor
+    std::string perFlowStatsFile = "cellular_city_flows.xml";
+    std::string statsOut;           // arquivo binário com as métricas por fluxo
+    bool flowLog       = false;     // uma linha de log por fluxo no fim
+    double sampleInterval = 0.0;    // ms de tempo simulado; 0 sem série temporal
+    std::string sampleOut = "cellular_city_kpis.csv";
+    uint32_t sampleBuffer = 1024;   // amostras no buffer circular
+    std::string scheduler = "map";  // escalonador de eventos do ns-3
+    bool eventProfile = false;      // tempo dos eventos por tipo
+    uint32_t profileTop = 20;       // tipos na tabela do perfil
+    std::string profileOut;         // pilhas dobradas para flamegraph
+    double pathlossCacheRes = 0.0;  // m; 0 desliga o cache de perda
+    bool pooledTraffic = false;     // um gerador CBR para todos os UEs
+    uint32_t trafficSlots = 1;      // posições da roda do gerador agrupado
+    std::string ueMobility = "walk"; // walk ou lazy
+    bool memReport = false;         // memória por componente no fim
+    double memBudget = 0.0;         // GB; estimativa de UEs que cabem
+    bool leanUe = false;            // UEs só com o que o cenário usa
+    bool packetArena = false;       // objetos pequenos em listas livres próprias
+    bool fixedStreams = false;      // streams do RNG por subsistema e índice
+    std::string traffic = "ul";     // perfil de tráfego: ul, dl, voip ou video
+    double warmup = 0.0;            // s; pacotes enviados antes ficam fora das métricas
+    double steadyStateCi = 0.0;     // meia-largura relativa alvo; 0 sem parada antecipada
+    double batchSize = 1.0;         // s; duração de um lote das médias em lotes
+    uint32_t minBatches = 10;
 
     CommandLine cmd;
     cmd.AddValue("nUes", "Número de UEs (usuários)", nUes);
     cmd.AddValue("simTime", "Tempo de simulação (s)", simTime);
     cmd.AddValue("tech", "Tecnologia: 4g ou 5g", tech);
     cmd.AddValue("verbose", "Imprimir mais logs", verbose);
+    cmd.AddValue("perFlowStats",
+                 "Instalar o FlowMonitor e guardar histogramas por fluxo (mais memória)",
+                 perFlowStats);
+    cmd.AddValue("perFlowStatsFile", "Arquivo XML do FlowMonitor com --perFlowStats",
+                 perFlowStatsFile);
+    cmd.AddValue("monitorFraction",
+                 "Fração dos UEs com FlowMonitor (< 1: amostra reprodutível, KPIs estimados "
+                 "com IC; implica --perFlowStats)",
+                 monitorFraction);
+    cmd.AddValue("statsOut",
+                 "Arquivo binário colunar com as métricas por fluxo (formato em "
+                 "cellular_city_statsout.h)",
+                 statsOut);
+    cmd.AddValue("flowLog", "Imprimir uma linha de log por fluxo no fim (lento com muitos UEs)",
+                 flowLog);
+    cmd.AddValue("sampleInterval",
+                 "Intervalo (ms de tempo simulado) da série temporal de indicadores (0: desligada)",
+                 sampleInterval);
+    cmd.AddValue("sampleOut", "CSV da série temporal com --sampleInterval", sampleOut);
+    cmd.AddValue("sampleBuffer", "Amostras no buffer circular da série temporal", sampleBuffer);
+    cmd.AddValue("scheduler",
+                 "Escalonador de eventos: map, heap, list, calendar, priority ou wheel",
+                 scheduler);
+    cmd.AddValue("profile",
+                 "Medir o tempo de cada evento do Simulator::Run() por tipo (contador de "
+                 "ciclos) e imprimir os tipos mais caros",
+                 eventProfile);
+    cmd.AddValue("profileTop", "Tipos de evento na tabela de --profile", profileTop);
+    cmd.AddValue("profileOut",
+                 "Com --profile, gravar as pilhas dobradas (flamegraph.pl) neste arquivo",
+                 profileOut);
+    cmd.AddValue("pathlossCacheRes",
+                 "Resolução (m) do cache de perda de percurso por par UE/eNodeB (0: desligado)",
+                 pathlossCacheRes);
+    cmd.AddValue("pooledTraffic",
+                 "Usar um único gerador CBR para todos os UEs (padrão: um UdpClient por UE, "
+                 "como na linha de base)",
+                 pooledTraffic);
+    cmd.AddValue("trafficSlots",
+                 "Fases do gerador agrupado dentro do intervalo (1: todos os UEs juntos)",
+                 trafficSlots);
+    cmd.AddValue("ueMobility",
+                 "Mobilidade dos UEs: walk (RandomWalk2d) ou lazy (mesmo passeio calculado "
+                 "na consulta, sem eventos)",
+                 ueMobility);
+    cmd.AddValue("memReport",
+                 "Imprimir a memória (heap) de cada componente da montagem, por UE",
+                 memReport);
+    cmd.AddValue("memBudget",
+                 "Com --memReport, estimar quantos UEs cabem neste orçamento (GB)",
+                 memBudget);
+    cmd.AddValue("leanUe",
+                 "UEs sem pilha IPv6 e só com roteamento estático (menos memória por UE)",
+                 leanUe);
+    cmd.AddValue("packetArena",
+                 "Servir os objetos pequenos (pacotes, buffers, eventos) de uma arena com "
+                 "listas livres por tamanho, com estatísticas no fim (requer compilar "
+                 "com -DCELLULAR_CITY_PACKET_ARENA)",
+                 packetArena);
+    cmd.AddValue("fixedStreams",
+                 "Streams do gerador aleatório fixos por subsistema e índice do UE, "
+                 "independentes da ordem de construção",
+                 fixedStreams);
+    cmd.AddValue("traffic",
+                 "Perfil de tráfego: ul (CBR de subida), dl (CBR de descida), voip (voz nos "
+                 "dois sentidos, com talkspurts) ou video (quadros em rajada na descida)",
+                 traffic);
+    cmd.AddValue("warmup",
+                 "Aquecimento (s): pacotes enviados antes disso ficam fora das métricas",
+                 warmup);
+    cmd.AddValue("steadyStateCi",
+                 "Parar quando a meia-largura do IC de 95% do atraso e do throughput, por "
+                 "médias em lotes, ficar abaixo desta fração da média (0: desligado)",
+                 steadyStateCi);
+    cmd.AddValue("batchSize", "Duração (s) de cada lote com --steadyStateCi", batchSize);
+    cmd.AddValue("minBatches", "Lotes mínimos antes de parar com --steadyStateCi", minBatches);
     cmd.Parse(argc, argv);
 
-    if (verbose)
+    // Daqui em diante os new/delete de até 1 KB usam a arena
+    NS_ABORT_MSG_IF(packetArena && !SmallObjectArena::kCompiled,
+                    "--packetArena requer compilar com -DCELLULAR_CITY_PACKET_ARENA");
+    NS_ABORT_MSG_IF(packetArena && !SmallObjectArena::Get().Enable(),
+                    "Não foi possível reservar a região da --packetArena");
+
+    NS_ABORT_MSG_IF(warmup < 0 || warmup >= simTime, "--warmup deve estar entre 0 e --simTime");
+    NS_ABORT_MSG_IF(monitorFraction <= 0 || monitorFraction > 1,
+                    "--monitorFraction deve estar em (0, 1]");
+    // A amostra do FlowMonitor mede os fluxos que chegam ao host remoto
+    NS_ABORT_MSG_IF(monitorFraction < 1.0 && traffic != "ul",
+                    "--monitorFraction requer --traffic=ul");
+    if (monitorFraction < 1.0)
+    {
+        perFlowStats = true;
+    }
+
+    ConfigureScheduler(scheduler, eventProfile);
+
+    if (verbose || flowLog)
     {
         LogComponentEnable("CellularCitySim", LOG_LEVEL_INFO);
     }
@@ -52,70 +192,28 @@ main(int argc, char *argv[])
     NS_LOG_INFO("Iniciando simulação com " << nUes
                  << " UEs, tecnologia = " << tech);
 
+    // Tempo de relógio de cada seção da montagem, impresso antes do Run()
+    PhaseTimer setupTimer;
+    MemoryFootprint footprint;
+
     // -------------------------
     // 1) Helpers LTE + EPC
     // -------------------------
-    Ptr<LteHelper> lteHelper = CreateObject<LteHelper>();
-    Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper>();
-    lteHelper->SetEpcHelper(epcHelper);
-
-    // Ajustes de “perfil” para 4G x 5G
-    // (usando o mesmo módulo LTE, mas com parâmetros diferentes)
-    if (tech == "4g")
+    CityTopology topology(tech);
+    Ptr<LteHelper> lteHelper = topology.GetLteHelper();
+    ConfigurePathloss(lteHelper, pathlossCacheRes);
+    if (leanUe)
     {
-        // Emular 4G: banda menor
-        lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(50)); // RBs
-        lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(50));
+        topology.SetLeanUes();
     }
-    else if (tech == "5g")
-    {
-        // Emular 5G: mais banda
-        lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(100)); // RBs
-        lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(100));
-        // Poderia ajustar scheduler, MIMO, etc. aqui
-    }
-    else
-    {
-        NS_ABORT_MSG("Valor inválido para --tech (use 4g ou 5g)");
-    }
-
-    Ptr<Node> pgw = epcHelper->GetPgwNode();
+    setupTimer.Mark("1) Helpers LTE + EPC");
 
     // -------------------------
     // 2) Host remoto (Internet)
     // -------------------------
-    NodeContainer remoteHostContainer;
-    remoteHostContainer.Create(1);
-    Ptr<Node> remoteHost = remoteHostContainer.Get(0);
-
-    InternetStackHelper internet;
-    internet.Install(remoteHostContainer);
-
-    // Link P2P entre PGW e host remoto
-    PointToPointHelper p2ph;
-    // Aqui podemos usar um atraso menor no “5G” para emular núcleo mais rápido
-    if (tech == "4g")
-    {
-        p2ph.SetDeviceAttribute("DataRate", StringValue("10Gbps"));
-        p2ph.SetChannelAttribute("Delay", StringValue("10ms"));
-    }
-    else // 5g
-    {
-        p2ph.SetDeviceAttribute("DataRate", StringValue("10Gbps"));
-        p2ph.SetChannelAttribute("Delay", StringValue("2ms"));
-    }
-
-    NetDeviceContainer internetDevs = p2ph.Install(pgw, remoteHost);
-    Ipv4AddressHelper ipv4h;
-    ipv4h.SetBase("1.0.0.0", "255.0.0.0");
-    Ipv4InterfaceContainer internetIfaces = ipv4h.Assign(internetDevs);
-
-    Ipv4StaticRoutingHelper ipv4RoutingHelper;
-    Ptr<Ipv4StaticRouting> remoteHostStaticRouting =
-        ipv4RoutingHelper.GetStaticRouting(remoteHost->GetObject<Ipv4>());
-    // Rede dos UEs: 7.x.x.x
-    remoteHostStaticRouting->AddNetworkRouteTo(
-        Ipv4Address("7.0.0.0"), Ipv4Mask("255.0.0.0"), 1);
+    topology.BuildRemoteHost();
+    setupTimer.Mark("2) Host remoto");
+    footprint.Mark("Helpers, EPC e host remoto", false);
 
     // -------------------------
     // 3) Nós da célula (eNodeB + UEs)
@@ -131,164 +229,235 @@ main(int argc, char *argv[])
     mobilityEnb.Install(enbNodes);
     enbNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 30.0));
 
-    MobilityHelper mobilityUe;
-    mobilityUe.SetPositionAllocator(
-        "ns3::RandomRectanglePositionAllocator",
-        "X", StringValue("ns3::UniformRandomVariable[Min=-500.0|Max=500.0]"),
-        "Y", StringValue("ns3::UniformRandomVariable[Min=-500.0|Max=500.0]"));
-    mobilityUe.SetMobilityModel(
-        "ns3::RandomWalk2dMobilityModel",
-        "Bounds", RectangleValue(Rectangle(-500, 500, -500, 500)),
-        "Speed", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=2.0]"));
-    mobilityUe.Install(ueNodes);
+    Ptr<RandomRectanglePositionAllocator> uePositions =
+        CreateObject<RandomRectanglePositionAllocator>();
+    uePositions->SetAttribute("X", StringValue("ns3::UniformRandomVariable[Min=-500.0|Max=500.0]"));
+    uePositions->SetAttribute("Y", StringValue("ns3::UniformRandomVariable[Min=-500.0|Max=500.0]"));
+    if (fixedStreams)
+    {
+        uePositions->AssignStreams(CityStreams::kPositions);
+    }
+    CityTopology::InstallUeMobility(ueNodes, uePositions, 500.0, ueMobility);
+    setupTimer.Mark("3) Nos e mobilidade");
+    footprint.Mark("Nos e mobilidade");
 
     // -------------------------
     // 4) Dispositivos LTE
     // -------------------------
-    NetDeviceContainer enbDevs = lteHelper->InstallEnbDevice(enbNodes);
-    NetDeviceContainer ueDevs  = lteHelper->InstallUeDevice(ueNodes);
-
-    // Pilha IP nos UEs
-    internet.Install(ueNodes);
-    Ipv4InterfaceContainer ueIfaces =
-        epcHelper->AssignUeIpv4Address(NetDeviceContainer(ueDevs));
+    NetDeviceContainer enbDevs = topology.InstallEnbs(enbNodes);
+    footprint.Mark("eNodeB: dispositivo", false);
 
-    // Rota default dos UEs -> PGW
-    for (uint16_t i = 0; i < nUes; ++i)
+    // Pilha IP, endereços e rota default dos UEs -> PGW
+    topology.InstallUes(ueNodes, &footprint);
+    const NetDeviceContainer& ueDevs = topology.GetUeDevices();
+    if (fixedStreams)
     {
-        Ptr<Node> ue = ueNodes.Get(i);
-        Ptr<Ipv4StaticRouting> ueStaticRouting =
-            ipv4RoutingHelper.GetStaticRouting(ue->GetObject<Ipv4>());
-        ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(), 1);
+        CityStreams::Assign(lteHelper, enbDevs, {0}, ueNodes, ueDevs,
+                            CityStreams::Sequence(nUes));
     }
 
     // Todos os UEs conectados ao mesmo eNodeB (célula única)
-    for (uint16_t i = 0; i < nUes; ++i)
+    for (uint32_t i = 0; i < nUes; ++i)
     {
         lteHelper->Attach(ueDevs.Get(i), enbDevs.Get(0));
     }
+    setupTimer.Mark("4) Dispositivos LTE e pilha IP");
+    footprint.Mark("Associacao");
 
     // -------------------------
     // 5) Aplicações (tráfego)
     // -------------------------
-    // Modelamos tráfego sensível a atraso (UDP CBR) dos UEs -> host remoto.
-    uint16_t dlPort = 1234;
-
-    // Servidor UDP no host remoto
-    UdpServerHelper udpServer(dlPort);
-    ApplicationContainer serverApps = udpServer.Install(remoteHost);
-    serverApps.Start(Seconds(0.1));
-    serverApps.Stop(Seconds(simTime));
-
-    // Clientes UDP em todos os UEs
-    ApplicationContainer clientApps;
-    double packetInterval = 0.1; // 100 ms -> 10 pacotes/s
-    uint32_t packetSize   = 200;  // bytes (aprox. VoIP/game)
-
-    for (uint16_t i = 0; i < nUes; ++i)
+    // Modelamos tráfego sensível a atraso (UDP CBR) dos UEs -> host remoto
+    // (padrão: 100 ms -> 10 pacotes/s, 200 bytes, aprox. VoIP/game) ou, com
+    // --traffic, os outros perfis de TrafficProfile.
+    uint16_t dlPort       = 1234; // UdpServer do host remoto (subida)
+    uint16_t ueSinkPort   = 1235; // sockets de recepção dos UEs (descida)
+    TrafficProfile profile = TrafficProfile::Parse(traffic, 0.1, 200);
+    double packetInterval = profile.interval;
+    uint32_t packetSize   = profile.packetSize;
+
+    UplinkCbrTraffic uplinkTraffic(topology.GetRemoteHost(), topology.GetRemoteAddress(), dlPort,
+                                   Seconds(packetInterval), packetSize, pooledTraffic,
+                                   trafficSlots);
+    if (profile.voice)
     {
-        UdpClientHelper udpClient(internetIfaces.GetAddress(1), dlPort);
-        udpClient.SetAttribute("MaxPackets", UintegerValue(0xFFFFFFFF));
-        udpClient.SetAttribute("Interval", TimeValue(Seconds(packetInterval)));
-        udpClient.SetAttribute("PacketSize", UintegerValue(packetSize));
-
-        clientApps.Add(udpClient.Install(ueNodes.Get(i)));
+        uplinkTraffic.SetVoice(CityStreams::Sequence(nUes));
     }
-
-    clientApps.Start(Seconds(0.5));
-    clientApps.Stop(Seconds(simTime));
+    if (profile.uplink)
+    {
+        uplinkTraffic.Install(ueNodes, Seconds(0.5), Seconds(simTime));
+    }
+    std::unique_ptr<DownlinkTraffic> downlinkTraffic;
+    if (profile.downlink)
+    {
+        downlinkTraffic = std::make_unique<DownlinkTraffic>(
+            topology, ueSinkPort, Seconds(packetInterval), packetSize, trafficSlots);
+        if (profile.video)
+        {
+            downlinkTraffic->SetVideo();
+        }
+        if (profile.voice)
+        {
+            downlinkTraffic->SetVoice(CityStreams::Sequence(nUes));
+        }
+        downlinkTraffic->Install(ueNodes, Seconds(0.5), Seconds(simTime));
+        if (fixedStreams)
+        {
+            downlinkTraffic->AssignStreams(CityStreams::Traffic(CityStreams::Sequence(nUes)));
+        }
+    }
+    setupTimer.Mark("5) Aplicacoes");
+    footprint.Mark("Aplicacoes");
 
     // -------------------------
-    // 6) FlowMonitor (métricas)
+    // 6) Métricas
     // -------------------------
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    // Contadores globais e histogramas fixos atualizados durante a simulação
+    // pelo gerador (ou UdpClients) e pelo trace do UdpServer. O FlowMonitor,
+    // com histogramas por fluxo, só é instalado quando pedido com
+    // --perFlowStats. As métricas principais são as da subida; só da descida
+    // com --traffic=dl/video. Com --traffic=voip a descida tem as suas.
+    CityMetricsCollector collector;
+    collector.GetMetrics().SetWarmup(Seconds(warmup));
+    std::unique_ptr<CityMetricsCollector> downlinkCollector;
+    if (profile.uplink)
+    {
+        uplinkTraffic.ConnectMetrics(collector.GetMetrics(), topology.GetUeInterfaces());
+    }
+    if (profile.downlink)
+    {
+        CityMetricsCollector* target = &collector;
+        if (profile.uplink)
+        {
+            downlinkCollector = std::make_unique<CityMetricsCollector>();
+            downlinkCollector->GetMetrics().SetWarmup(Seconds(warmup));
+            target = downlinkCollector.get();
+        }
+        downlinkTraffic->ConnectMetrics(target->GetMetrics(), topology.GetUeInterfaces());
+    }
+
+    std::unique_ptr<KpiSampler> sampler;
+    if (sampleInterval > 0)
+    {
+        sampler = std::make_unique<KpiSampler>(collector.GetMetrics(),
+                                               Seconds(sampleInterval / 1000.0), sampleBuffer,
+                                               sampleOut);
+        sampler->Start(Seconds(0.5));
+    }
+    if (monitorFraction < 1.0)
+    {
+        uint32_t monitored = collector.EnableSampledFlowStats(
+            ueNodes, topology.GetRemoteHost(), monitorFraction, Seconds(warmup));
+        NS_LOG_INFO("FlowMonitor em " << monitored << " de " << nUes << " UEs");
+    }
+    else if (perFlowStats)
+    {
+        collector.EnablePerFlowStats(Seconds(warmup));
+    }
+    std::unique_ptr<SteadyStateDetector> steadyState;
+    if (steadyStateCi > 0)
+    {
+        steadyState = std::make_unique<SteadyStateDetector>(
+            collector.GetMetrics(), Seconds(batchSize), steadyStateCi, minBatches);
+        steadyState->Start(Seconds(std::max(warmup, 0.5)));
+    }
+    setupTimer.Mark("6) Metricas");
+    footprint.Mark("Metricas e FlowMonitor");
+    setupTimer.Print(std::cout);
 
     Simulator::Stop(Seconds(simTime));
+    auto runStart = std::chrono::steady_clock::now();
+    EventProfiler::Get().Start();
     Simulator::Run();
+    EventProfiler::Get().Finish();
+    double runWallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    if (sampler)
+    {
+        sampler->Finish();
+    }
+    // Contextos de UE, bearers e buffers criados pela conexão RRC
+    footprint.Mark("Durante a simulacao");
+    // Com --steadyStateCi a simulação pode parar antes de simTime; as taxas
+    // usam o tempo entre o fim do aquecimento e a parada.
+    double endTime = Simulator::Now().GetSeconds();
+    double window = endTime - warmup;
 
     // -------------------------
     // 7) Processar resultados
     // -------------------------
-    monitor->CheckForLostPackets();
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-    Ptr<Ipv4FlowClassifier> classifier =
-        DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-
-    double   totalDelay      = 0.0;
-    double   totalJitter     = 0.0;
-    uint64_t totalRxPackets  = 0;
-    uint64_t totalRxBytes    = 0;
-    uint64_t totalLostPackets = 0;
-
-    for (auto const &flow : stats)
+    if (flowLog)
     {
-        FlowId id = flow.first;
-        FlowMonitor::FlowStats fs = flow.second;
-        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(id);
-
-        double throughputMbps = (fs.rxBytes * 8.0) / (simTime * 1e6);
-        double meanDelayMs = 0.0;
-        if (fs.rxPackets > 0)
-        {
-            meanDelayMs = (fs.delaySum.GetSeconds() / fs.rxPackets) * 1000.0;
-        }
-
-        NS_LOG_INFO("Flow " << id
-                     << " (" << t.sourceAddress << " -> " << t.destinationAddress << "): "
-                     << "Throughput = " << throughputMbps << " Mbps, "
-                     << "Atraso médio = " << meanDelayMs << " ms, "
-                     << "RxPackets = " << fs.rxPackets << ", "
-                     << "LostPackets = " << fs.lostPackets);
-
-        totalDelay      += fs.delaySum.GetSeconds();
-        if (fs.rxPackets > 1)
+        for (uint32_t i = 0; i < collector.GetMetrics().GetNFlows(); ++i)
         {
-            // jitterSum é a soma das variações de atraso entre pacotes consecutivos
-            totalJitter += fs.jitterSum.GetSeconds();
+            NS_LOG_INFO(collector.DescribeFlow(i, topology.GetRemoteAddress(), window));
         }
-        totalRxPackets   += fs.rxPackets;
-        totalRxBytes     += fs.rxBytes;
-        totalLostPackets += fs.lostPackets;
     }
 
-    double meanDelayMs    = 0.0;
-    double jitterMs       = 0.0;
-    double throughputMbps = 0.0;
-    double lossRatePct    = 0.0;
-
-    if (totalRxPackets > 0)
+    if (perFlowStats)
     {
-        double meanDelay  = totalDelay / (double)totalRxPackets; // s
-        double meanJitter = 0.0;
-
-        if (totalRxPackets > 1)
-        {
-            // Aproximação: jitter médio = jitterSum_total / (N-1)
-            meanJitter = totalJitter / (double)(totalRxPackets - 1);
-        }
-
-        meanDelayMs    = meanDelay  * 1000.0;
-        jitterMs       = meanJitter * 1000.0;
-        throughputMbps = (totalRxBytes * 8.0) / (simTime * 1e6);
+        collector.WritePerFlowStats(perFlowStatsFile);
+        NS_LOG_INFO("Estatísticas por fluxo (FlowMonitor) em " << perFlowStatsFile);
     }
 
-    uint64_t totalOfferedPackets = totalRxPackets + totalLostPackets;
-    if (totalOfferedPackets > 0)
+    if (!statsOut.empty())
     {
-        lossRatePct = (double)totalLostPackets * 100.0 / (double)totalOfferedPackets;
+        // Com subida (ul, voip) o arquivo tem os fluxos de subida
+        FlowStatsWriter(collector.GetMetrics(), topology.GetRemoteAddress(),
+                        profile.uplink ? dlPort : downlinkTraffic->GetSourcePort(), window,
+                        !profile.uplink)
+            .Write(statsOut);
+        NS_LOG_INFO("Métricas por fluxo em " << statsOut);
     }
 
+    StreamingMetrics::Totals totals = collector.GetMetrics().GetTotals();
+
     std::cout << "================ RESULTADOS (" << tech << ") ================" << std::endl;
     std::cout << "Usuarios (UEs):            " << nUes << std::endl;
-    std::cout << "Tempo de simulacao (s):    " << simTime << std::endl;
-    std::cout << "Atraso medio (ms):         " << meanDelayMs << std::endl;
-    std::cout << "Jitter medio (ms):         " << jitterMs << std::endl;
-    std::cout << "Throughput total (Mbps):   " << throughputMbps << std::endl;
-    std::cout << "Taxa de perda (%):         " << lossRatePct << std::endl;
-    std::cout << "Pacotes recebidos:         " << totalRxPackets << std::endl;
-    std::cout << "Pacotes perdidos:          " << totalLostPackets << std::endl;
+    std::cout << "Tempo de simulacao (s):    " << endTime << std::endl;
+    if (warmup > 0)
+    {
+        std::cout << "Aquecimento (s):           " << warmup << std::endl;
+        std::cout << "Janela de medida (s):      " << window << std::endl;
+    }
+    std::cout << "Perfil de trafego:         " << traffic << std::endl;
+    if (downlinkCollector)
+    {
+        std::cout << "---------------- subida ----------------" << std::endl;
+    }
+    collector.PrintKpis(std::cout, totals, window);
+    if (collector.IsSampled())
+    {
+        CityMetricsCollector::PrintSampleEstimate(
+            std::cout, collector.GetSampleSums(topology.GetRemoteAddress(), window), nUes);
+    }
+    if (downlinkCollector)
+    {
+        std::cout << "---------------- descida ----------------" << std::endl;
+        downlinkCollector->PrintKpis(std::cout, downlinkCollector->GetMetrics().GetTotals(),
+                                     window, " descida");
+    }
     std::cout << "==================================================" << std::endl;
+    if (steadyState)
+    {
+        steadyState->Print(std::cout);
+    }
+    PrintSchedulerReport(std::cout, scheduler, runWallSeconds);
+    if (eventProfile)
+    {
+        EventProfiler::Get().Print(std::cout, profileTop);
+        NS_ABORT_MSG_IF(!profileOut.empty() && !EventProfiler::Get().WriteFolded(profileOut),
+                        "Não foi possível criar " << profileOut);
+    }
+    PrintPathlossReport(std::cout);
+    if (memReport)
+    {
+        footprint.Print(std::cout, nUes, memBudget);
+    }
+    if (packetArena)
+    {
+        SmallObjectArena::Get().Print(std::cout);
+    }
 
     Simulator::Destroy();
     return 0;
@@ -0,0 +1,213 @@
+/*
+ * cellular_city_statsout.h
+ *
+ * Exportação das métricas por fluxo (--statsOut) em um arquivo binário
+ * colunar, no lugar de uma linha de texto por fluxo. Todos os inteiros e
+ * doubles são little-endian (ordem nativa de x86/ARM).
+ *
+ * Formato (versão 2):
+ *
+ *   cabeçalho, 32 bytes
+ *     char     magic[8]     "CCSTATS\0"
+ *     uint32   version      2
+ *     uint32   nColumns
+ *     uint64   nFlows
+ *     double   simTime      janela de medida (s), sem o aquecimento
+ *
+ *   diretório, nColumns entradas de 32 bytes
+ *     char     name[24]     nome da coluna, terminado em '\0'
+ *     char     kind         'u' (sem sinal), 'i' (com sinal) ou 'f' (IEEE 754)
+ *     uint8    pad[3]
+ *     uint32   size         bytes por valor
+ *
+ *   dados: as colunas, na ordem do diretório, cada uma com nFlows valores
+ *   contíguos.
+ *
+ * Colunas da versão 2: flowId, srcAddr, dstAddr (IPv4 como uint32),
+ * srcPort, dstPort, protocol, txPackets, rxPackets, lostPackets, rxBytes,
+ * delaySum (s), jitterSum (s), throughput (Mbps), weight (UEs representados
+ * pelo fluxo; os contadores do fluxo são por pacote agregado) e direction
+ * (0 subida, 1 descida). A origem e o destino seguem o sentido do fluxo: na
+ * subida o UE envia para o host remoto, na descida o host remoto envia para
+ * o UE. A versão 1 não tinha direction e gravava sempre UE -> host remoto.
+ */
+
+#ifndef CELLULAR_CITY_STATSOUT_H
+#define CELLULAR_CITY_STATSOUT_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+
+#include "cellular_city_metrics.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class FlowStatsWriter
+{
+  public:
+    static constexpr uint32_t kVersion = 2;
+
+    /// remotePort é a porta do host remoto no fluxo: a do UdpServer na
+    /// subida, a do socket do gerador na descida (downlink = true). A porta
+    /// do UE vem de StreamingMetrics::GetFlowPort().
+    FlowStatsWriter(const StreamingMetrics& metrics,
+                    Ipv4Address remoteAddress,
+                    uint16_t remotePort,
+                    double simTime,
+                    bool downlink = false)
+        : m_metrics(metrics),
+          m_remoteAddress(remoteAddress),
+          m_remotePort(remotePort),
+          m_simTime(simTime),
+          m_downlink(downlink)
+    {
+    }
+
+    /// Grava o arquivo em path; aborta se não for possível criá-lo.
+    void Write(const std::string& path)
+    {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        NS_ABORT_MSG_IF(!os, "Não foi possível criar " << path);
+
+        const StreamingMetrics& m = m_metrics;
+        uint64_t nFlows = m.GetNFlows();
+        uint32_t remote = m_remoteAddress.Get();
+        uint16_t remotePort = m_remotePort;
+        double simTime = m_simTime;
+        bool downlink = m_downlink;
+
+        // Diretório: nome, tipo e largura de cada coluna, na ordem de escrita
+        m_columns.clear();
+        AddColumn("flowId", 'u', 4);
+        AddColumn("srcAddr", 'u', 4);
+        AddColumn("dstAddr", 'u', 4);
+        AddColumn("srcPort", 'u', 2);
+        AddColumn("dstPort", 'u', 2);
+        AddColumn("protocol", 'u', 1);
+        AddColumn("txPackets", 'u', 4);
+        AddColumn("rxPackets", 'u', 4);
+        AddColumn("lostPackets", 'u', 4);
+        AddColumn("rxBytes", 'u', 8);
+        AddColumn("delaySum", 'f', 8);
+        AddColumn("jitterSum", 'f', 8);
+        AddColumn("throughput", 'f', 8);
+        AddColumn("weight", 'u', 4);
+        AddColumn("direction", 'u', 1);
+
+        char magic[8] = {'C', 'C', 'S', 'T', 'A', 'T', 'S', '\0'};
+        os.write(magic, sizeof(magic));
+        WriteValue(os, kVersion);
+        WriteValue(os, static_cast<uint32_t>(m_columns.size()));
+        WriteValue(os, nFlows);
+        WriteValue(os, simTime);
+        for (const Column& c : m_columns)
+        {
+            os.write(c.name, sizeof(c.name));
+            os.write(&c.kind, 1);
+            char pad[3] = {0, 0, 0};
+            os.write(pad, sizeof(pad));
+            WriteValue(os, c.size);
+        }
+
+        WriteColumn<uint32_t>(os, nFlows, [](uint32_t i) { return i; });
+        auto ueAddress = [&m](uint32_t i) { return m.GetFlowAddress(i).Get(); };
+        auto uePort = [&m](uint32_t i) { return m.GetFlowPort(i); };
+        auto remoteAddress = [remote](uint32_t) { return remote; };
+        auto remotePortOf = [remotePort](uint32_t) { return remotePort; };
+        if (downlink)
+        {
+            WriteColumn<uint32_t>(os, nFlows, remoteAddress);
+            WriteColumn<uint32_t>(os, nFlows, ueAddress);
+            WriteColumn<uint16_t>(os, nFlows, remotePortOf);
+            WriteColumn<uint16_t>(os, nFlows, uePort);
+        }
+        else
+        {
+            WriteColumn<uint32_t>(os, nFlows, ueAddress);
+            WriteColumn<uint32_t>(os, nFlows, remoteAddress);
+            WriteColumn<uint16_t>(os, nFlows, uePort);
+            WriteColumn<uint16_t>(os, nFlows, remotePortOf);
+        }
+        WriteColumn<uint8_t>(os, nFlows, [](uint32_t) { return uint8_t(17); }); // UDP
+        WriteColumn<uint32_t>(os, nFlows, [&m](uint32_t i) { return m.GetFlow(i).txPackets; });
+        WriteColumn<uint32_t>(os, nFlows, [&m](uint32_t i) { return m.GetFlow(i).rxPackets; });
+        WriteColumn<uint32_t>(os, nFlows, [&m](uint32_t i) {
+            return StreamingMetrics::GetLostPackets(m.GetFlow(i));
+        });
+        WriteColumn<uint64_t>(os, nFlows, [&m](uint32_t i) { return m.GetFlow(i).rxBytes; });
+        WriteColumn<double>(os, nFlows, [&m](uint32_t i) {
+            return TimeStep(m.GetFlow(i).delaySum).GetSeconds();
+        });
+        WriteColumn<double>(os, nFlows, [&m](uint32_t i) {
+            return TimeStep(m.GetFlow(i).jitterSum).GetSeconds();
+        });
+        WriteColumn<double>(os, nFlows, [&m, simTime](uint32_t i) {
+            return (m.GetFlow(i).rxBytes * 8.0) / (simTime * 1e6);
+        });
+        WriteColumn<uint32_t>(os, nFlows, [&m](uint32_t i) { return m.GetFlow(i).weight; });
+        WriteColumn<uint8_t>(os, nFlows, [downlink](uint32_t) { return uint8_t(downlink); });
+
+        NS_ABORT_MSG_IF(!os, "Erro de escrita em " << path);
+    }
+
+  private:
+    struct Column
+    {
+        char name[24];
+        char kind;
+        uint32_t size;
+    };
+
+    /// Valores convertidos por bloco antes de cada escrita
+    static constexpr uint32_t kChunk = 65536;
+
+    void AddColumn(const char* name, char kind, uint32_t size)
+    {
+        Column c = {};
+        std::strncpy(c.name, name, sizeof(c.name) - 1);
+        c.kind = kind;
+        c.size = size;
+        m_columns.push_back(c);
+    }
+
+    template <typename T>
+    static void WriteValue(std::ofstream& os, T value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T, typename F>
+    void WriteColumn(std::ofstream& os, uint64_t nFlows, F value)
+    {
+        std::vector<T> chunk;
+        chunk.reserve(kChunk);
+        for (uint64_t i = 0; i < nFlows; ++i)
+        {
+            chunk.push_back(value(i));
+            if (chunk.size() == kChunk)
+            {
+                os.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(T));
+                chunk.clear();
+            }
+        }
+        os.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(T));
+    }
+
+    const StreamingMetrics& m_metrics;
+    Ipv4Address m_remoteAddress;
+    uint16_t m_remotePort;
+    double m_simTime;
+    bool m_downlink;
+    std::vector<Column> m_columns;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_STATSOUT_H */
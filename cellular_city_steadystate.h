@@ -0,0 +1,152 @@
+/*
+ * cellular_city_steadystate.h
+ *
+ * Detecção de regime estacionário por médias em lotes (--steadyStateCi).
+ * Depois do aquecimento, a cada lote de batchSize segundos simulados o
+ * SteadyStateDetector calcula o atraso médio e o throughput do lote a
+ * partir dos contadores correntes (StreamingMetrics::GetRunningTotals()).
+ * Com pelo menos minBatches lotes, se a meia-largura do intervalo de
+ * confiança de 95% das duas médias ficar abaixo de ciTarget (fração da
+ * média), a simulação é parada com Simulator::Stop().
+ *
+ * Os lotes devem ser longos em relação à correlação entre pacotes
+ * (escalonador, HARQ, filas) para que as médias sejam quase independentes.
+ */
+
+#ifndef CELLULAR_CITY_STEADYSTATE_H
+#define CELLULAR_CITY_STEADYSTATE_H
+
+#include "ns3/core-module.h"
+
+#include "cellular_city_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ns3
+{
+
+class SteadyStateDetector
+{
+  public:
+    SteadyStateDetector(const StreamingMetrics& metrics,
+                        Time batchSize,
+                        double ciTarget,
+                        uint32_t minBatches)
+        : m_metrics(metrics),
+          m_batchSize(batchSize),
+          m_ciTarget(ciTarget),
+          m_minBatches(std::max<uint32_t>(minBatches, 2)),
+          m_stopped(false),
+          m_delayHalfWidth(0.0),
+          m_throughputHalfWidth(0.0)
+    {
+    }
+
+    /// O primeiro lote começa em start (o fim do aquecimento).
+    void Start(Time start)
+    {
+        Simulator::Schedule(start - Simulator::Now(), &SteadyStateDetector::BeginBatches, this);
+    }
+
+    bool Stopped() const { return m_stopped; }
+    uint32_t GetNBatches() const { return m_delay.size(); }
+
+    /// Bloco ESTADO ESTACIONARIO do resumo.
+    void Print(std::ostream& os) const
+    {
+        os << "================ ESTADO ESTACIONARIO ================" << std::endl;
+        os << "Lote (s):                  " << m_batchSize.GetSeconds() << std::endl;
+        os << "Lotes medidos:             " << m_delay.size() << std::endl;
+        os << "Meia-largura alvo (%):     " << m_ciTarget * 100.0 << std::endl;
+        os << "IC 95% atraso (%):         " << m_delayHalfWidth * 100.0 << std::endl;
+        os << "IC 95% throughput (%):     " << m_throughputHalfWidth * 100.0 << std::endl;
+        os << "Parada antecipada:         " << (m_stopped ? "sim" : "nao") << std::endl;
+        os << "=====================================================" << std::endl;
+    }
+
+  private:
+    void BeginBatches()
+    {
+        m_previous = m_metrics.GetRunningTotals();
+        Simulator::Schedule(m_batchSize, &SteadyStateDetector::EndBatch, this);
+    }
+
+    void EndBatch()
+    {
+        StreamingMetrics::RunningCounters now = m_metrics.GetRunningTotals();
+        uint64_t rx = now.rxPackets - m_previous.rxPackets;
+        if (rx > 0)
+        {
+            m_delay.push_back(TimeStep(now.delaySum - m_previous.delaySum).GetSeconds() / rx);
+            m_throughput.push_back((now.rxBytes - m_previous.rxBytes) * 8.0 /
+                                   m_batchSize.GetSeconds());
+        }
+        m_previous = now;
+
+        if (m_delay.size() >= m_minBatches)
+        {
+            m_delayHalfWidth = RelativeHalfWidth(m_delay);
+            m_throughputHalfWidth = RelativeHalfWidth(m_throughput);
+            if (m_delayHalfWidth < m_ciTarget && m_throughputHalfWidth < m_ciTarget)
+            {
+                m_stopped = true;
+                Simulator::Stop();
+                return;
+            }
+        }
+        Simulator::Schedule(m_batchSize, &SteadyStateDetector::EndBatch, this);
+    }
+
+    /// Quantil 0.975 da t de Student com dof graus de liberdade (expansão de
+    /// Cornish-Fisher a partir da normal; erro < 1% para dof >= 3).
+    static double StudentT975(uint32_t dof)
+    {
+        const double z = 1.959964;
+        double z3 = z * z * z;
+        double z5 = z3 * z * z;
+        double v = dof;
+        return z + (z3 + z) / (4.0 * v) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * v * v);
+    }
+
+    /// Meia-largura do IC de 95% da média dos lotes, relativa à média.
+    static double RelativeHalfWidth(const std::vector<double>& batches)
+    {
+        uint32_t n = batches.size();
+        double mean = 0.0;
+        for (double b : batches)
+        {
+            mean += b;
+        }
+        mean /= n;
+        double var = 0.0;
+        for (double b : batches)
+        {
+            var += (b - mean) * (b - mean);
+        }
+        var /= (n - 1);
+        if (mean <= 0.0)
+        {
+            return INFINITY;
+        }
+        return StudentT975(n - 1) * std::sqrt(var / n) / mean;
+    }
+
+    const StreamingMetrics& m_metrics;
+    Time m_batchSize;
+    double m_ciTarget;
+    uint32_t m_minBatches;
+    StreamingMetrics::RunningCounters m_previous;
+    std::vector<double> m_delay;      // s, um valor por lote
+    std::vector<double> m_throughput; // bit/s, um valor por lote
+    bool m_stopped;
+    double m_delayHalfWidth;
+    double m_throughputHalfWidth;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_STEADYSTATE_H */
@@ -0,0 +1,122 @@
+/*
+ * cellular_city_streams.h
+ *
+ * Streams fixos do gerador aleatório por subsistema (--fixedStreams). Sem
+ * AssignStreams, cada variável aleatória do ns-3 recebe o próximo stream
+ * livre na ordem em que é criada, e qualquer mudança na ordem de construção
+ * (outra ordem dos eNodeBs, outro particionamento) troca os
+ * números de todo o cenário. Aqui cada subsistema tem uma faixa própria, e
+ * dentro dela o stream depende só do índice global do UE ou do eNodeB:
+ *
+ *   kPositions    posições iniciais dos UEs (x, y)
+ *   kFading       modelo de desvanecimento do LteHelper, se houver
+ *   kEnbBase      + kPerDevice * eNodeB: PHY, MAC e escalonador, RRC
+ *   kUeBase       + kPerDevice * UE: PHY, MAC (acesso aleatório), RRC
+ *   kMobilityBase + kPerMobility * UE: velocidade e direção do passeio
+ *   kTrafficBase  + kPerTraffic * UE: tamanho dos quadros de vídeo
+ *
+ * Com os mesmos --RngSeed/--RngRun, o mesmo UE (ou eNodeB) usa os mesmos
+ * números em qualquer ordem de construção.
+ */
+
+#ifndef CELLULAR_CITY_STREAMS_H
+#define CELLULAR_CITY_STREAMS_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+class CityStreams
+{
+  public:
+    static constexpr int64_t kPositions = 0;
+    static constexpr int64_t kFading = 16;
+    static constexpr int64_t kEnbBase = int64_t(1) << 40;
+    static constexpr int64_t kUeBase = int64_t(2) << 40;
+    static constexpr int64_t kMobilityBase = int64_t(3) << 40;
+    static constexpr int64_t kTrafficBase = int64_t(4) << 40;
+    static constexpr int64_t kPerDevice = 64;
+    static constexpr int64_t kPerMobility = 4;
+    static constexpr int64_t kPerTraffic = 1;
+
+    /// Streams das coordenadas x e y das posições iniciais dos UEs.
+    static void AssignPositions(Ptr<RandomVariableStream> x, Ptr<RandomVariableStream> y)
+    {
+        x->SetStream(kPositions);
+        y->SetStream(kPositions + 1);
+    }
+
+    /**
+     * eNodeBs (enbKeys[k]: índice global do eNodeB enbDevs[k]), UEs
+     * (ueKeys[i]: índice global do UE ues[i]) e a mobilidade dos UEs.
+     * Chamar depois de instalar os UEs e antes de parar algum com Freeze().
+     */
+    static void Assign(Ptr<LteHelper> lteHelper,
+                       const NetDeviceContainer& enbDevs,
+                       const std::vector<uint64_t>& enbKeys,
+                       const NodeContainer& ues,
+                       const NetDeviceContainer& ueDevs,
+                       const std::vector<uint64_t>& ueKeys)
+    {
+        NS_ASSERT(enbKeys.size() == enbDevs.GetN());
+        NS_ASSERT(ueKeys.size() == ues.GetN() && ueKeys.size() == ueDevs.GetN());
+        // A primeira chamada do LteHelper também sorteia o desvanecimento
+        lteHelper->AssignStreams(NetDeviceContainer(), kFading);
+        for (uint32_t k = 0; k < enbDevs.GetN(); ++k)
+        {
+            AssignDevice(lteHelper, enbDevs.Get(k), kEnbBase + kPerDevice * enbKeys[k]);
+        }
+        for (uint32_t i = 0; i < ues.GetN(); ++i)
+        {
+            AssignDevice(lteHelper, ueDevs.Get(i), kUeBase + kPerDevice * ueKeys[i]);
+
+            Ptr<MobilityModel> mm = ues.Get(i)->GetObject<MobilityModel>();
+            int64_t used = mm->AssignStreams(kMobilityBase + kPerMobility * ueKeys[i]);
+            NS_ABORT_MSG_IF(used > kPerMobility, "Mobilidade usa " << used << " streams");
+            // O passeio já sorteou o primeiro trecho ao receber a posição;
+            // sorteia de novo, agora com os streams fixos
+            mm->SetPosition(mm->GetPosition());
+        }
+    }
+
+    /// Streams do tráfego de cada UE (ueKeys[i]: índice global do UE i),
+    /// para DownlinkTraffic::AssignStreams().
+    static std::vector<int64_t> Traffic(const std::vector<uint64_t>& ueKeys)
+    {
+        std::vector<int64_t> streams(ueKeys.size());
+        for (uint32_t i = 0; i < ueKeys.size(); ++i)
+        {
+            streams[i] = kTrafficBase + kPerTraffic * ueKeys[i];
+        }
+        return streams;
+    }
+
+    /// Índices 0, 1, ..., n - 1.
+    static std::vector<uint64_t> Sequence(uint32_t n)
+    {
+        std::vector<uint64_t> keys(n);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            keys[i] = i;
+        }
+        return keys;
+    }
+
+  private:
+    static void AssignDevice(Ptr<LteHelper> lteHelper, Ptr<NetDevice> dev, int64_t stream)
+    {
+        int64_t used = lteHelper->AssignStreams(NetDeviceContainer(dev), stream);
+        NS_ABORT_MSG_IF(used > kPerDevice, "Dispositivo LTE usa " << used << " streams");
+    }
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_STREAMS_H */
@@ -0,0 +1,344 @@
+/*
+ * cellular_city_sweep.cc
+ *
+ * Varredura de parâmetros: lê uma grade de configurações, executa cada uma
+ * como um processo independente das simulações (cellular_city_sim ou
+ * cellular_city_multicell_sim) em um pool de processos do tamanho da máquina
+ * e junta os blocos RESULTADOS em uma única tabela CSV.
+ *
+ * Formato do arquivo de varredura: uma grade por linha, com tokens
+ * chave=v1,v2,... separados por espaço. Cada linha gera o produto cartesiano
+ * dos valores. Chaves especiais:
+ *   program=<caminho>  binário a executar (padrão: --program)
+ *   runs=<N>           repetições de cada configuração (RngRun diferentes)
+ * As demais chaves são repassadas como --chave=valor. Linhas iniciadas por
+ * '#' são comentários.
+ *
+ *   # sweep.txt
+ *   tech=4g,5g nUes=200,1000,5000 nEnbs=7 areaSize=2000 simTime=30 runs=3
+ *
+ * Exemplo de uso (a partir da pasta build/):
+ *
+ *   ./ns3.cellular_city_sweep --sweep=sweep.txt --jobs=64 --output=sweep.csv
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "ns3/core-module.h"
+
+#include "cellular_city_runner.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("CellularCitySweep");
+
+namespace
+{
+
+// Uma execução da varredura: binário, parâmetros e semente (RngRun).
+struct SweepRun
+{
+    uint32_t index;
+    std::string program;
+    std::vector<std::pair<std::string, std::string>> params;
+    uint32_t rngRun;
+
+    // preenchidos após a execução
+    std::string status;
+    double wallSeconds = 0.0;
+    long maxRssKb = 0;
+    std::map<std::string, std::string> results;
+};
+
+std::vector<std::string>
+Split(const std::string& s, char sep)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep))
+    {
+        if (!item.empty())
+        {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+// Expande cada linha do arquivo no produto cartesiano dos seus valores.
+std::vector<SweepRun>
+ReadSweepFile(const std::string& path, const std::string& defaultProgram, uint32_t rngBase)
+{
+    std::ifstream in(path);
+    NS_ABORT_MSG_IF(!in, "Não foi possível abrir o arquivo de varredura " << path);
+
+    std::vector<SweepRun> runs;
+    std::string line;
+    uint32_t lineNo = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNo;
+        line = Trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> keys;
+        std::vector<std::vector<std::string>> values;
+        std::string program = defaultProgram;
+        uint32_t repetitions = 1;
+
+        std::istringstream tokens(line);
+        std::string token;
+        while (tokens >> token)
+        {
+            size_t eq = token.find('=');
+            NS_ABORT_MSG_IF(eq == std::string::npos || eq == 0,
+                            "Linha " << lineNo << ": token inválido '" << token << "'");
+            std::string key = token.substr(0, eq);
+            std::string value = token.substr(eq + 1);
+            if (key == "program")
+            {
+                program = value;
+            }
+            else if (key == "runs")
+            {
+                repetitions = std::stoul(value);
+            }
+            else
+            {
+                keys.push_back(key);
+                values.push_back(Split(value, ','));
+                NS_ABORT_MSG_IF(values.back().empty(),
+                                "Linha " << lineNo << ": chave '" << key << "' sem valores");
+            }
+        }
+
+        // Contador "odômetro" sobre as listas de valores
+        std::vector<size_t> pos(keys.size(), 0);
+        bool done = false;
+        while (!done)
+        {
+            for (uint32_t rep = 0; rep < repetitions; ++rep)
+            {
+                SweepRun run;
+                run.index = runs.size();
+                run.program = program;
+                run.rngRun = rngBase + run.index;
+                for (size_t k = 0; k < keys.size(); ++k)
+                {
+                    run.params.emplace_back(keys[k], values[k][pos[k]]);
+                }
+                runs.push_back(run);
+            }
+
+            done = true;
+            for (size_t k = keys.size(); k-- > 0;)
+            {
+                if (++pos[k] < values[k].size())
+                {
+                    done = false;
+                    break;
+                }
+                pos[k] = 0;
+            }
+        }
+    }
+    return runs;
+}
+
+// Dispara a execução em um processo filho com stdout/stderr em outPath.
+pid_t
+LaunchRun(const SweepRun& run, const std::string& outPath)
+{
+    std::vector<std::string> args;
+    args.push_back(run.program);
+    for (const auto& p : run.params)
+    {
+        args.push_back("--" + p.first + "=" + p.second);
+    }
+    args.push_back("--RngRun=" + std::to_string(run.rngRun));
+    return LaunchProcess(args, outPath);
+}
+
+// Guarda os valores dos blocos de resumo da execução e registra as colunas
+// novas na ordem em que aparecem.
+void
+ParseResults(const std::string& outPath,
+             SweepRun& run,
+             std::vector<std::string>& resultColumns)
+{
+    for (const SummaryLine& line : ReadSummaryBlocks(outPath))
+    {
+        if (run.results.find(line.label) == run.results.end() &&
+            std::find(resultColumns.begin(), resultColumns.end(), line.label) ==
+                resultColumns.end())
+        {
+            resultColumns.push_back(line.label);
+        }
+        run.results[line.label] = line.value;
+    }
+}
+
+std::string
+CsvQuote(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"')
+        {
+            out += '"';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    std::string sweepFile;
+    std::string program = "./ns3.cellular_city_multicell_sim";
+    std::string output  = "sweep_results.csv";
+    std::string workDir = "sweep_runs";
+    uint32_t    jobs    = std::thread::hardware_concurrency();
+    uint32_t    rngBase = 1;
+
+    CommandLine cmd;
+    cmd.AddValue("sweep", "Arquivo com a grade de configurações", sweepFile);
+    cmd.AddValue("program", "Binário da simulação usado quando a linha não define program=",
+                 program);
+    cmd.AddValue("output", "Tabela CSV consolidada", output);
+    cmd.AddValue("workDir", "Pasta para a saída de cada execução", workDir);
+    cmd.AddValue("jobs", "Número de simulações simultâneas (padrão: núcleos da máquina)", jobs);
+    cmd.AddValue("rngBase", "RngRun da primeira execução (as demais somam o índice)", rngBase);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(sweepFile.empty(), "Informe o arquivo de varredura com --sweep=<arquivo>");
+    if (jobs == 0)
+    {
+        jobs = 1;
+    }
+
+    std::vector<SweepRun> runs = ReadSweepFile(sweepFile, program, rngBase);
+    NS_ABORT_MSG_IF(runs.empty(), "Nenhuma configuração em " << sweepFile);
+    mkdir(workDir.c_str(), 0755);
+
+    std::cout << "Varredura: " << runs.size() << " execuções, " << jobs << " simultâneas"
+              << std::endl;
+
+    using Clock = std::chrono::steady_clock;
+    std::map<pid_t, std::pair<uint32_t, Clock::time_point>> running;
+    std::vector<std::string> resultColumns;
+    size_t next = 0;
+    size_t finished = 0;
+
+    auto outPathOf = [&workDir](const SweepRun& run) {
+        return workDir + "/run-" + std::to_string(run.index) + ".out";
+    };
+
+    while (next < runs.size() || !running.empty())
+    {
+        while (running.size() < jobs && next < runs.size())
+        {
+            SweepRun& run = runs[next++];
+            pid_t pid = LaunchRun(run, outPathOf(run));
+            running[pid] = {run.index, Clock::now()};
+        }
+
+        ChildExit child = WaitAnyProcess();
+        auto it = running.find(child.pid);
+        if (it == running.end())
+        {
+            continue;
+        }
+
+        SweepRun& run = runs[it->second.first];
+        run.wallSeconds =
+            std::chrono::duration<double>(Clock::now() - it->second.second).count();
+        running.erase(it);
+
+        run.status = DescribeExit(child.status);
+        run.maxRssKb = child.maxRssKb;
+        ParseResults(outPathOf(run), run, resultColumns);
+
+        ++finished;
+        std::cout << "[" << finished << "/" << runs.size() << "] execução " << run.index
+                  << " (RngRun=" << run.rngRun << "): " << run.status << ", "
+                  << run.wallSeconds << " s" << std::endl;
+    }
+
+    // Colunas de parâmetros: união das chaves, na ordem em que aparecem
+    std::vector<std::string> paramColumns;
+    for (const auto& run : runs)
+    {
+        for (const auto& p : run.params)
+        {
+            if (std::find(paramColumns.begin(), paramColumns.end(), p.first) ==
+                paramColumns.end())
+            {
+                paramColumns.push_back(p.first);
+            }
+        }
+    }
+
+    std::ofstream csv(output);
+    NS_ABORT_MSG_IF(!csv, "Não foi possível criar " << output);
+    csv << "run,RngRun,program";
+    for (const auto& c : paramColumns)
+    {
+        csv << "," << CsvQuote(c);
+    }
+    csv << ",status,wallTime_s,maxRss_kB";
+    for (const auto& c : resultColumns)
+    {
+        csv << "," << CsvQuote(c);
+    }
+    csv << "\n";
+
+    uint32_t failed = 0;
+    for (const auto& run : runs)
+    {
+        csv << run.index << "," << run.rngRun << "," << CsvQuote(run.program);
+        for (const auto& c : paramColumns)
+        {
+            std::string value;
+            for (const auto& p : run.params)
+            {
+                if (p.first == c)
+                {
+                    value = p.second;
+                }
+            }
+            csv << "," << CsvQuote(value);
+        }
+        csv << "," << run.status << "," << run.wallSeconds << "," << run.maxRssKb;
+        for (const auto& c : resultColumns)
+        {
+            auto r = run.results.find(c);
+            csv << "," << CsvQuote(r != run.results.end() ? r->second : "");
+        }
+        csv << "\n";
+        failed += (run.status != "ok");
+    }
+
+    std::cout << "Tabela consolidada em " << output << " (" << failed << " falhas)"
+              << std::endl;
+    return failed == 0 ? 0 : 1;
+}
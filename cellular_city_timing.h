@@ -0,0 +1,76 @@
+/*
+ * cellular_city_timing.h
+ *
+ * Medição do tempo de relógio (wall-clock) gasto em cada fase da montagem
+ * das simulações da cidade, antes de Simulator::Run().
+ */
+
+#ifndef CELLULAR_CITY_TIMING_H
+#define CELLULAR_CITY_TIMING_H
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Cada Mark() fecha a fase corrente com o tempo decorrido desde o Mark()
+ * anterior (ou desde a construção).
+ */
+class PhaseTimer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    PhaseTimer()
+        : m_start(Clock::now()),
+          m_last(m_start)
+    {
+    }
+
+    void Mark(const std::string& phase)
+    {
+        Clock::time_point now = Clock::now();
+        m_phases.emplace_back(phase, std::chrono::duration<double>(now - m_last).count());
+        m_last = now;
+    }
+
+    const std::vector<std::pair<std::string, double>>& GetPhases() const
+    {
+        return m_phases;
+    }
+
+    double GetTotal() const
+    {
+        return std::chrono::duration<double>(m_last - m_start).count();
+    }
+
+    void Print(std::ostream& os) const
+    {
+        os << "================ TEMPO DE INICIALIZACAO ================" << std::endl;
+        for (const auto& phase : m_phases)
+        {
+            std::string label = phase.first + " (s):";
+            label.resize(std::max<size_t>(label.size() + 1, 36), ' ');
+            os << label << phase.second << std::endl;
+        }
+        std::string total = "Total (s):";
+        total.resize(36, ' ');
+        os << total << GetTotal() << std::endl;
+        os << "========================================================" << std::endl;
+    }
+
+  private:
+    Clock::time_point m_start;
+    Clock::time_point m_last;
+    std::vector<std::pair<std::string, double>> m_phases;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_TIMING_H */
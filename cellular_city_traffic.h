@@ -0,0 +1,485 @@
+/*
+ * cellular_city_traffic.h
+ *
+ * Gerador CBR agrupado para o tráfego de subida dos UEs: um único objeto,
+ * com uma roda de temporização de nSlots posições, envia os pacotes de todos
+ * os UEs, no lugar de um UdpClient (Application + timer) por UE. O ganho é
+ * um evento por posição da roda no lugar de um por UE; cada pacote ainda é
+ * um Send() próprio no socket do UE.
+ *
+ * Cada UE continua com o seu socket UDP, e os pacotes são idênticos aos do
+ * UdpClient (SeqTsHeader + payload, total de packetSize bytes). Com
+ * nSlots = 1 todos os UEs enviam no mesmo instante, como UdpClients
+ * iniciados juntos; com nSlots > 1 os UEs são espalhados em fases dentro do
+ * intervalo. Uma fonte pode ter tamanho de pacote próprio (os agrupamentos
+ * de UEs da simulação multi-célula enviam a soma dos pacotes dos membros).
+ *
+ * PooledDownlinkTraffic faz o mesmo no sentido contrário, a partir de um
+ * único socket no host remoto, com um SendTo() por pacote.
+ *
+ * VoiceActivity liga e desliga as fontes em períodos de fala e de silêncio
+ * (perfil voip).
+ */
+
+#ifndef CELLULAR_CITY_TRAFFIC_H
+#define CELLULAR_CITY_TRAFFIC_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/seq-ts-header.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Modelo liga/desliga de voz: cada fonte alterna entre períodos de fala
+ * (talkspurts) e de silêncio com durações exponenciais, de médias
+ * kMeanTalkSpurt e kMeanSilence (ITU-T P.59), e só envia durante a fala. No
+ * primeiro envio a fonte começa em fala com a probabilidade estacionária.
+ *
+ * As durações vêm de um hash de (--RngSeed, --RngRun, salt, chave da fonte,
+ * número do período), sem uma variável aleatória por fonte: com a chave
+ * igual ao índice global do UE, cada UE fala nos mesmos instantes em
+ * qualquer ordem de construção. Os dois sentidos usam salts diferentes e
+ * são independentes (não há alternância entre os interlocutores).
+ */
+class VoiceActivity
+{
+  public:
+    static constexpr double kMeanTalkSpurt = 1.004; // s
+    static constexpr double kMeanSilence = 1.587;   // s
+
+    explicit VoiceActivity(uint64_t salt)
+        : m_seed(Mix(Mix(RngSeedManager::GetSeed()) ^ RngSeedManager::GetRun()) ^ Mix(salt))
+    {
+    }
+
+    /// Fonte seguinte (índices em ordem de chamada), com a chave key.
+    void AddSource(uint64_t key)
+    {
+        m_sources.push_back(Source{key, -1, 0, false});
+    }
+
+    /// Se a fonte está em fala em Simulator::Now().
+    bool IsTalking(uint32_t index)
+    {
+        Source& s = m_sources[index];
+        int64_t now = Simulator::Now().GetTimeStep();
+        if (s.next < 0)
+        {
+            s.talking = Uniform(s.key, 0) < kMeanTalkSpurt / (kMeanTalkSpurt + kMeanSilence);
+            s.next = now + Draw(s);
+        }
+        while (now >= s.next)
+        {
+            s.talking = !s.talking;
+            s.next += Draw(s);
+        }
+        return s.talking;
+    }
+
+  private:
+    struct Source
+    {
+        uint64_t key;
+        int64_t next;   // TimeStep da próxima troca; -1 antes do primeiro envio
+        uint32_t draws; // períodos sorteados
+        bool talking;
+    };
+
+    /// Finalizador do splitmix64.
+    static uint64_t Mix(uint64_t z)
+    {
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// Uniforme em [0, 1).
+    double Uniform(uint64_t key, uint64_t n) const
+    {
+        return (Mix(Mix(m_seed ^ key) ^ n) >> 11) * 0x1.0p-53;
+    }
+
+    int64_t Draw(Source& s) const
+    {
+        double mean = s.talking ? kMeanTalkSpurt : kMeanSilence;
+        double duration = -mean * std::log1p(-Uniform(s.key, ++s.draws));
+        return std::max<int64_t>(1, Seconds(duration).GetTimeStep());
+    }
+
+    uint64_t m_seed;
+    std::vector<Source> m_sources;
+};
+
+class PooledCbrTraffic
+{
+  public:
+    PooledCbrTraffic(const Address& remote, Time interval, uint32_t packetSize, uint32_t nSlots = 1)
+        : m_remote(remote),
+          m_interval(interval),
+          m_slots(nSlots == 0 ? 1 : nSlots)
+    {
+        SeqTsHeader seqTs;
+        NS_ABORT_MSG_IF(packetSize < seqTs.GetSerializedSize(),
+                        "PacketSize menor que o SeqTsHeader");
+        // Payload compartilhado: as cópias dividem o mesmo buffer (copy-on-write)
+        m_payload = Create<Packet>(packetSize - seqTs.GetSerializedSize());
+        m_payloadBySize[packetSize] = m_payload;
+    }
+
+    /// Cria o socket UDP do UE e o coloca em uma posição da roda. Com
+    /// packetSize != 0 a fonte envia pacotes desse tamanho no lugar do
+    /// tamanho do construtor. Devolve o índice da fonte, na ordem de chamada.
+    uint32_t AddSource(Ptr<Node> node, uint32_t packetSize = 0)
+    {
+        uint32_t index = m_sockets.size();
+        if (packetSize != 0)
+        {
+            Ptr<Packet>& payload = m_payloadBySize[packetSize];
+            if (!payload)
+            {
+                SeqTsHeader seqTs;
+                NS_ABORT_MSG_IF(packetSize < seqTs.GetSerializedSize(),
+                                "PacketSize menor que o SeqTsHeader");
+                payload = Create<Packet>(packetSize - seqTs.GetSerializedSize());
+            }
+            m_sourcePayloads.resize(index + 1);
+            m_sourcePayloads[index] = payload;
+        }
+        Ptr<Socket> socket = Socket::CreateSocket(node, UdpSocketFactory::GetTypeId());
+        socket->Bind();
+        socket->Connect(m_remote);
+
+        m_sockets.push_back(socket);
+        m_sent.push_back(0);
+        m_slots[index % m_slots.size()].push_back(index);
+        return index;
+    }
+
+    /// Chamado com o índice da fonte a cada pacote enviado.
+    void SetTxCallback(Callback<void, uint32_t> cb)
+    {
+        m_txCallback = cb;
+    }
+
+    /// Enviar só nos períodos de fala de voice (índices das fontes).
+    void SetVoiceActivity(VoiceActivity* voice)
+    {
+        m_voice = voice;
+    }
+
+    void Start(Time start)
+    {
+        int64_t phase = m_interval.GetTimeStep() / static_cast<int64_t>(m_slots.size());
+        for (uint32_t s = 0; s < m_slots.size(); ++s)
+        {
+            if (!m_slots[s].empty())
+            {
+                Simulator::Schedule(start - Simulator::Now() + TimeStep(phase * s),
+                                    &PooledCbrTraffic::SendSlot,
+                                    this,
+                                    s);
+            }
+        }
+    }
+
+    void Stop(Time stop)
+    {
+        m_stop = stop;
+    }
+
+    uint32_t GetNSources() const { return m_sockets.size(); }
+
+  private:
+    void SendSlot(uint32_t slot)
+    {
+        if (!m_stop.IsZero() && Simulator::Now() >= m_stop)
+        {
+            return;
+        }
+
+        for (uint32_t index : m_slots[slot])
+        {
+            if (m_voice && !m_voice->IsTalking(index))
+            {
+                continue;
+            }
+            SeqTsHeader seqTs;
+            seqTs.SetSeq(m_sent[index]);
+            Ptr<Packet> p = index < m_sourcePayloads.size() && m_sourcePayloads[index]
+                                ? m_sourcePayloads[index]->Copy()
+                                : m_payload->Copy();
+            p->AddHeader(seqTs);
+            if (m_sockets[index]->Send(p) >= 0)
+            {
+                ++m_sent[index];
+                if (!m_txCallback.IsNull())
+                {
+                    m_txCallback(index);
+                }
+            }
+        }
+
+        Simulator::Schedule(m_interval, &PooledCbrTraffic::SendSlot, this, slot);
+    }
+
+    Address m_remote;
+    Time m_interval;
+    Time m_stop;
+    Ptr<Packet> m_payload;
+    std::map<uint32_t, Ptr<Packet>> m_payloadBySize;
+    std::vector<Ptr<Packet>> m_sourcePayloads; // vazio enquanto todas usam m_payload
+    std::vector<Ptr<Socket>> m_sockets;
+    std::vector<uint32_t> m_sent;
+    std::vector<std::vector<uint32_t>> m_slots;
+    Callback<void, uint32_t> m_txCallback;
+    VoiceActivity* m_voice = nullptr;
+};
+
+/**
+ * Gerador agrupado do tráfego de descida: um único socket UDP no host remoto
+ * envia, a cada intervalo, um pacote (ou um quadro em rajada) para cada UE,
+ * com a mesma roda de nSlots posições do PooledCbrTraffic. Os pacotes levam
+ * o SeqTsHeader, como os de subida, e cada um é um SendTo() próprio. Em
+ * cada UE um socket UDP na porta port recebe os pacotes e os entrega à
+ * callback de recepção com o índice da fonte; não há uma Application por UE
+ * em nenhum dos lados.
+ */
+class PooledDownlinkTraffic
+{
+  public:
+    PooledDownlinkTraffic(Ptr<Node> remoteHost, uint16_t port, Time interval, uint32_t nSlots = 1)
+        : m_port(port),
+          m_interval(interval),
+          m_maxFrameBytes(0),
+          m_maxPacketSize(0),
+          m_slots(nSlots == 0 ? 1 : nSlots)
+    {
+        m_socket = Socket::CreateSocket(remoteHost, UdpSocketFactory::GetTypeId());
+        m_socket->Bind();
+    }
+
+    /// Tráfego em rajadas: a cada intervalo cada fonte envia um quadro, com
+    /// o tamanho sorteado pela variável da fonte (limitado a maxFrameBytes,
+    /// vezes o peso da fonte), em pacotes de até maxPacketSize bytes, no
+    /// lugar de um pacote de tamanho fixo. Chamar antes de AddSource().
+    void SetBursty(uint32_t maxFrameBytes, uint32_t maxPacketSize)
+    {
+        SeqTsHeader seqTs;
+        NS_ABORT_MSG_IF(maxPacketSize < seqTs.GetSerializedSize(),
+                        "Pacote do quadro menor que o SeqTsHeader");
+        NS_ASSERT(m_destinations.empty() && maxFrameBytes > 0);
+        m_maxFrameBytes = maxFrameBytes;
+        m_maxPacketSize = maxPacketSize;
+    }
+
+    /// Cria o socket de recepção do UE e coloca a fonte (pacotes de
+    /// packetSize bytes para address, ou, com SetBursty(), quadros de
+    /// frameBytes bytes com peso weight) em uma posição da roda. Devolve o
+    /// índice da fonte, na ordem de chamada.
+    uint32_t AddSource(Ptr<Node> ue,
+                       Ipv4Address address,
+                       uint32_t packetSize,
+                       uint32_t weight = 1,
+                       Ptr<RandomVariableStream> frameBytes = nullptr)
+    {
+        NS_ASSERT((m_maxFrameBytes > 0) == bool(frameBytes));
+        SeqTsHeader seqTs;
+        NS_ABORT_MSG_IF(packetSize < seqTs.GetSerializedSize(), "PacketSize menor que o SeqTsHeader");
+        uint32_t index = m_destinations.size();
+        Ptr<Socket> sink = Socket::CreateSocket(ue, UdpSocketFactory::GetTypeId());
+        sink->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port));
+        sink->SetRecvCallback(MakeBoundCallback(&PooledDownlinkTraffic::HandleRead, this, index));
+
+        m_sinks.push_back(sink);
+        m_destinations.push_back(InetSocketAddress(address, m_port));
+        m_sizes.push_back(packetSize);
+        m_weights.push_back(weight);
+        if (frameBytes)
+        {
+            m_frameBytes.push_back(frameBytes);
+        }
+        m_sent.push_back(0);
+        m_slots[index % m_slots.size()].push_back(index);
+        return index;
+    }
+
+    /// Chamado com o índice da fonte a cada pacote enviado.
+    void SetTxCallback(Callback<void, uint32_t> cb)
+    {
+        m_txCallback = cb;
+    }
+
+    /// Chamado com o pacote e o índice da fonte a cada pacote recebido.
+    void SetRxCallback(Callback<void, Ptr<const Packet>, uint32_t> cb)
+    {
+        m_rxCallback = cb;
+    }
+
+    /// Como PooledCbrTraffic::SetVoiceActivity().
+    void SetVoiceActivity(VoiceActivity* voice)
+    {
+        m_voice = voice;
+    }
+
+    /// Troca o número de posições da roda. Chamar antes de AddSource().
+    void SetNSlots(uint32_t nSlots)
+    {
+        NS_ASSERT(m_destinations.empty() && nSlots > 0);
+        m_slots.assign(nSlots, std::vector<uint32_t>());
+    }
+
+    uint32_t GetNSlots() const { return m_slots.size(); }
+
+    /// Maior número de pacotes que uma fonte de peso weight envia por
+    /// intervalo: um, ou o quadro máximo em pacotes.
+    uint64_t GetBurstPackets(uint32_t weight) const
+    {
+        return m_maxFrameBytes
+                   ? (uint64_t(m_maxFrameBytes) * weight + m_maxPacketSize - 1) / m_maxPacketSize
+                   : 1;
+    }
+
+    void Start(Time start)
+    {
+        int64_t phase = m_interval.GetTimeStep() / static_cast<int64_t>(m_slots.size());
+        for (uint32_t s = 0; s < m_slots.size(); ++s)
+        {
+            if (!m_slots[s].empty())
+            {
+                Simulator::Schedule(start - Simulator::Now() + TimeStep(phase * s),
+                                    &PooledDownlinkTraffic::SendSlot,
+                                    this,
+                                    s);
+            }
+        }
+    }
+
+    void Stop(Time stop)
+    {
+        m_stop = stop;
+    }
+
+    uint32_t GetNSources() const { return m_destinations.size(); }
+
+    /// Porta dos sockets de recepção dos UEs.
+    uint16_t GetPort() const { return m_port; }
+
+    /// Porta de origem dos pacotes: a efêmera atribuída ao socket do host
+    /// remoto no Bind().
+    uint16_t GetSourcePort() const
+    {
+        Address local;
+        m_socket->GetSockName(local);
+        return InetSocketAddress::ConvertFrom(local).GetPort();
+    }
+
+    /// Maior número de pacotes que uma posição da roda envia de uma vez
+    /// (a fila do host remoto tem de comportá-los).
+    uint64_t GetMaxBurstPackets() const
+    {
+        uint64_t most = 0;
+        for (const std::vector<uint32_t>& slot : m_slots)
+        {
+            uint64_t packets = 0;
+            for (uint32_t index : slot)
+            {
+                packets += GetBurstPackets(m_weights[index]);
+            }
+            most = std::max(most, packets);
+        }
+        return most;
+    }
+
+  private:
+    void SendSlot(uint32_t slot)
+    {
+        if (!m_stop.IsZero() && Simulator::Now() >= m_stop)
+        {
+            return;
+        }
+
+        for (uint32_t index : m_slots[slot])
+        {
+            if (m_voice && !m_voice->IsTalking(index))
+            {
+                continue;
+            }
+            if (m_maxFrameBytes == 0)
+            {
+                Send(index, m_sizes[index]);
+                continue;
+            }
+            // Quadro: pacotes cheios e o resto; cada um com a sua sequência
+            double frame = std::min<double>(m_frameBytes[index]->GetValue(), m_maxFrameBytes);
+            uint64_t bytes =
+                std::max<uint64_t>(1, static_cast<uint64_t>(frame * m_weights[index]));
+            while (bytes > 0)
+            {
+                uint32_t size = std::min<uint64_t>(bytes, m_maxPacketSize);
+                bytes -= size;
+                Send(index, size);
+            }
+        }
+
+        Simulator::Schedule(m_interval, &PooledDownlinkTraffic::SendSlot, this, slot);
+    }
+
+    void Send(uint32_t index, uint32_t size)
+    {
+        SeqTsHeader seqTs;
+        seqTs.SetSeq(m_sent[index]);
+        uint32_t header = seqTs.GetSerializedSize();
+        Ptr<Packet> p = Create<Packet>(size > header ? size - header : 0);
+        p->AddHeader(seqTs);
+        if (m_socket->SendTo(p, 0, m_destinations[index]) >= 0)
+        {
+            ++m_sent[index];
+            if (!m_txCallback.IsNull())
+            {
+                m_txCallback(index);
+            }
+        }
+    }
+
+    static void HandleRead(PooledDownlinkTraffic* self, uint32_t index, Ptr<Socket> socket)
+    {
+        while (Ptr<Packet> packet = socket->Recv())
+        {
+            if (!self->m_rxCallback.IsNull())
+            {
+                self->m_rxCallback(packet, index);
+            }
+        }
+    }
+
+    uint16_t m_port;
+    Time m_interval;
+    Time m_stop;
+    Ptr<Socket> m_socket;
+    uint32_t m_maxFrameBytes; // 0: CBR
+    uint32_t m_maxPacketSize;
+    std::vector<Ptr<Socket>> m_sinks;
+    std::vector<InetSocketAddress> m_destinations;
+    std::vector<uint32_t> m_sizes;
+    std::vector<uint32_t> m_weights;
+    std::vector<Ptr<RandomVariableStream>> m_frameBytes; // por fonte, com SetBursty()
+    std::vector<uint32_t> m_sent;
+    std::vector<std::vector<uint32_t>> m_slots;
+    Callback<void, uint32_t> m_txCallback;
+    Callback<void, Ptr<const Packet>, uint32_t> m_rxCallback;
+    VoiceActivity* m_voice = nullptr;
+};
+
+} // namespace ns3
+
+#endif /* CELLULAR_CITY_TRAFFIC_H */